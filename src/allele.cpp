@@ -0,0 +1,407 @@
+#include "allele.h"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+ShortString::ShortString(const char * data, size_t length)
+{
+  assign(data, length);
+}
+
+ShortString::ShortString(const std::string & string)
+{
+  assign(string.data(), string.length());
+}
+
+ShortString::ShortString(const ShortString & other)
+{
+  assign(other.data(), other.length());
+}
+
+ShortString::ShortString(ShortString && other) noexcept
+  : size(other.size)
+{
+  if (other.is_inline())
+  {
+    std::memcpy(local, other.local, size);
+  }
+  else
+  {
+    heap = other.heap;
+    other.size = 0;
+  }
+}
+
+ShortString::~ShortString()
+{
+  if (!is_inline())
+    delete[] heap;
+}
+
+ShortString & ShortString::operator = (const ShortString & other)
+{
+  if (this != &other)
+  {
+    this->~ShortString();
+    size = 0;
+    assign(other.data(), other.length());
+  }
+  return *this;
+}
+
+ShortString & ShortString::operator = (ShortString && other) noexcept
+{
+  if (this != &other)
+  {
+    this->~ShortString();
+    new (this) ShortString(std::move(other));
+  }
+  return *this;
+}
+
+void ShortString::assign(const char * data, size_t length)
+{
+  size = length;
+  if (is_inline())
+  {
+    std::memcpy(local, data, length);
+  }
+  else
+  {
+    heap = new char[length];
+    std::memcpy(heap, data, length);
+  }
+}
+
+bool ShortString::is_inline() const
+{
+  return size <= inline_capacity;
+}
+
+const char * ShortString::data() const
+{
+  return is_inline() ? local : heap;
+}
+
+size_t ShortString::length() const
+{
+  return size;
+}
+
+bool ShortString::empty() const
+{
+  return size == 0;
+}
+
+std::string ShortString::str() const
+{
+  return std::string(data(), size);
+}
+
+int ShortString::compare(const char * other, size_t other_length) const
+{
+  int result = std::memcmp(data(), other, std::min(size, other_length));
+  if (result != 0)
+    return result;
+
+  return size < other_length ? -1 : (size > other_length ? 1 : 0);
+}
+
+bool operator == (const ShortString & lhs, const ShortString & rhs)
+{
+  return lhs.size == rhs.size && std::memcmp(lhs.data(), rhs.data(), lhs.size) == 0;
+}
+
+bool operator < (const ShortString & lhs, const ShortString & rhs)
+{
+  return lhs.compare(rhs.data(), rhs.length()) < 0;
+}
+
+std::ostream & operator << (std::ostream & os, const ShortString & string)
+{
+  return os.write(string.data(), string.length());
+}
+
+AlleleDictionary::AlleleDictionary()
+{
+  for (auto & shard : shards)
+  {
+    shard.chunks.reset(new std::atomic<ShortString *>[max_chunks]);
+    for (size_t i = 0; i < max_chunks; ++i)
+      shard.chunks[i] = nullptr;
+  }
+}
+
+AlleleDictionary & AlleleDictionary::global()
+{
+  static AlleleDictionary dictionary;
+  return dictionary;
+}
+
+bool AlleleDictionary::KeyEqual::operator () (const Key & lhs, const Key & rhs) const
+{
+  return lhs.length == rhs.length && std::memcmp(lhs.data, rhs.data, lhs.length) == 0;
+}
+
+size_t AlleleDictionary::hash(const char * data, size_t length)
+{
+  // FNV-1a
+  uint64_t value = 14695981039346656037ull;
+  for (size_t i = 0; i < length; ++i)
+  {
+    value ^= static_cast<unsigned char>(data[i]);
+    value *= 1099511628211ull;
+  }
+  return value;
+}
+
+AlleleId AlleleDictionary::intern(const char * data, size_t length)
+{
+  Key key{data, length, hash(data, length)};
+  size_t shard_idx = key.hash >> (64 - shard_bits);
+  Shard & shard = shards[shard_idx];
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.ids.find(key);
+  if (iter != shard.ids.end())
+    return iter->second;
+
+  size_t idx = shard.count;
+  if ((idx >> chunk_bits) >= max_chunks)
+    throw std::length_error("Allele dictionary is full");
+
+  ShortString * chunk = shard.chunks[idx >> chunk_bits].load(std::memory_order_relaxed);
+  if (!chunk)
+  {
+    chunk = new ShortString[chunk_size];
+    shard.chunks[idx >> chunk_bits].store(chunk, std::memory_order_release);
+  }
+
+  ShortString & stored = chunk[idx & (chunk_size - 1)];
+  stored = ShortString(data, length);
+  shard.count++;
+
+  AlleleId id = static_cast<AlleleId>((idx << shard_bits) | shard_idx);
+  shard.ids.insert(std::make_pair(Key{stored.data(), stored.length(), key.hash}, id));
+  return id;
+}
+
+AlleleId AlleleDictionary::intern(const std::string & allele)
+{
+  return intern(allele.data(), allele.length());
+}
+
+const ShortString & AlleleDictionary::get(AlleleId id) const
+{
+  size_t idx = id >> shard_bits;
+  const ShortString * chunk = shards[id & (shard_count - 1)].chunks[idx >> chunk_bits].load(std::memory_order_acquire);
+  return chunk[idx & (chunk_size - 1)];
+}
+
+size_t AlleleDictionary::size() const
+{
+  size_t total = 0;
+  for (auto & shard : shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.count;
+  }
+  return total;
+}
+
+constexpr size_t AlleleEntry::max_interned_length;
+
+AlleleEntry::AlleleEntry(const char * data, size_t length)
+{
+  assign(data, length);
+}
+
+AlleleEntry::AlleleEntry(const AlleleEntry & other)
+{
+  if (other.is_interned())
+    bits = other.bits;
+  else
+    assign(other.data(), other.length());
+}
+
+AlleleEntry::AlleleEntry(AlleleEntry && other) noexcept
+  : bits(other.bits)
+{
+  other.bits = 1;
+}
+
+AlleleEntry::~AlleleEntry()
+{
+  release();
+}
+
+AlleleEntry & AlleleEntry::operator = (const AlleleEntry & other)
+{
+  if (this != &other)
+  {
+    release();
+    bits = 1;
+    if (other.is_interned())
+      bits = other.bits;
+    else
+      assign(other.data(), other.length());
+  }
+  return *this;
+}
+
+AlleleEntry & AlleleEntry::operator = (AlleleEntry && other) noexcept
+{
+  if (this != &other)
+  {
+    release();
+    bits = other.bits;
+    other.bits = 1;
+  }
+  return *this;
+}
+
+AlleleEntry AlleleEntry::interned(const char * data, size_t length)
+{
+  if (length > max_interned_length)
+    return AlleleEntry(data, length);
+
+  AlleleEntry entry;
+  entry.bits = (static_cast<uintptr_t>(AlleleDictionary::global().intern(data, length)) << 1) | 1;
+  return entry;
+}
+
+void AlleleEntry::assign(const char * data, size_t length)
+{
+  // new[] memory is aligned, the low bit of the pointer stays clear
+  size_t * block = new size_t[1 + (length + sizeof(size_t) - 1) / sizeof(size_t)];
+  block[0] = length;
+  std::memcpy(block + 1, data, length);
+  bits = reinterpret_cast<uintptr_t>(block);
+}
+
+void AlleleEntry::release()
+{
+  if (!is_interned())
+    delete[] reinterpret_cast<size_t *>(bits);
+}
+
+bool AlleleEntry::is_interned() const
+{
+  return (bits & 1) != 0;
+}
+
+AlleleId AlleleEntry::id() const
+{
+  return static_cast<AlleleId>(bits >> 1);
+}
+
+const char * AlleleEntry::data() const
+{
+  if (is_interned())
+    return AlleleDictionary::global().get(id()).data();
+  return reinterpret_cast<const char *>(reinterpret_cast<const size_t *>(bits) + 1);
+}
+
+size_t AlleleEntry::length() const
+{
+  if (is_interned())
+    return AlleleDictionary::global().get(id()).length();
+  return *reinterpret_cast<const size_t *>(bits);
+}
+
+std::string AlleleEntry::str() const
+{
+  return std::string(data(), length());
+}
+
+int AlleleEntry::compare(const char * other, size_t other_length) const
+{
+  if (is_interned())
+    return AlleleDictionary::global().get(id()).compare(other, other_length);
+
+  size_t size = length();
+  int result = std::memcmp(data(), other, std::min(size, other_length));
+  if (result != 0)
+    return result;
+
+  return size < other_length ? -1 : (size > other_length ? 1 : 0);
+}
+
+AlleleSet::Storage::const_iterator AlleleSet::lower_bound(const char * data, size_t length) const
+{
+  // sets are tiny, a linear scan beats binary search here
+  auto iter = alleles.begin();
+  while (iter != alleles.end() && iter->compare(data, length) < 0)
+    ++iter;
+  return iter;
+}
+
+bool AlleleSet::insert(const std::string & allele)
+{
+  return insert(allele.data(), allele.length());
+}
+
+bool AlleleSet::insert(const char * data, size_t length)
+{
+  return insert(data, length, false);
+}
+
+bool AlleleSet::intern(const std::string & allele)
+{
+  return insert(allele.data(), allele.length(), true);
+}
+
+bool AlleleSet::insert(const char * data, size_t length, bool interned)
+{
+  auto iter = lower_bound(data, length);
+  if (iter != alleles.end() && iter->compare(data, length) == 0)
+    return false;
+
+  if (interned)
+    alleles.emplace(iter, AlleleEntry::interned(data, length));
+  else
+    alleles.emplace(iter, data, length);
+  return true;
+}
+
+size_t AlleleSet::count(const std::string & allele) const
+{
+  auto iter = lower_bound(allele.data(), allele.length());
+  return iter != alleles.end() && iter->compare(allele.data(), allele.length()) == 0;
+}
+
+size_t AlleleSet::erase(const std::string & allele)
+{
+  auto iter = lower_bound(allele.data(), allele.length());
+  if (iter == alleles.end() || iter->compare(allele.data(), allele.length()) != 0)
+    return 0;
+
+  alleles.erase(iter);
+  return 1;
+}
+
+AlleleSet::const_iterator AlleleSet::begin() const
+{
+  return alleles.begin();
+}
+
+AlleleSet::const_iterator AlleleSet::end() const
+{
+  return alleles.end();
+}
+
+size_t AlleleSet::size() const
+{
+  return alleles.size();
+}
+
+bool AlleleSet::empty() const
+{
+  return alleles.empty();
+}
+
+void AlleleSet::swap(AlleleSet & other)
+{
+  alleles.swap(other.alleles);
+}
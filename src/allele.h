@@ -0,0 +1,232 @@
+#ifndef VCF2EDS_ALLELE_H
+#define VCF2EDS_ALLELE_H
+
+#include "utils/small_vector.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Allele sequence stored inside the object when it is short, on the heap otherwise.
+ */
+class ShortString
+{
+public:
+  static constexpr size_t inline_capacity = sizeof(char *) * 2;
+
+  ShortString() = default;
+  ShortString(const char * data, size_t length);
+  ShortString(const std::string & string);
+  ShortString(const ShortString & other);
+  ShortString(ShortString && other) noexcept;
+  ~ShortString();
+
+  ShortString & operator = (const ShortString & other);
+  ShortString & operator = (ShortString && other) noexcept;
+
+  const char * data() const;
+  size_t length() const;
+  bool empty() const;
+  std::string str() const;
+
+  int compare(const char * other, size_t other_length) const;
+
+  friend bool operator == (const ShortString & lhs, const ShortString & rhs);
+  friend bool operator < (const ShortString & lhs, const ShortString & rhs);
+  friend std::ostream & operator << (std::ostream & os, const ShortString & string);
+private:
+  void assign(const char * data, size_t length);
+  bool is_inline() const;
+
+  size_t size = 0;
+  union
+  {
+    char local[inline_capacity];
+    char * heap;
+  };
+};
+
+using AlleleId = uint32_t;
+
+/**
+ * Interning table for allele sequences - every distinct allele is stored once and
+ * referred to by a 32-bit id. Interning is thread-safe, the table is split into
+ * shards by hash and each shard has its own lock. Looking an id up takes no lock,
+ * stored alleles never move and are never released, which is why only alleles of
+ * VCF records of up to AlleleEntry::max_interned_length bases are interned. Those
+ * repeat all over a genome, while padded and merged alleles are mostly unique.
+ */
+class AlleleDictionary
+{
+public:
+  AlleleDictionary();
+
+  AlleleDictionary(const AlleleDictionary &) = delete;
+  AlleleDictionary & operator = (const AlleleDictionary &) = delete;
+
+  /**
+   * Dictionary of the alleles of VCF records, shared by segments and EDS.
+   */
+  static AlleleDictionary & global();
+
+  AlleleId intern(const char * data, size_t length);
+  AlleleId intern(const std::string & allele);
+
+  const ShortString & get(AlleleId id) const;
+
+  size_t size() const;
+private:
+  static constexpr size_t shard_bits = 4;
+  static constexpr size_t shard_count = 1 << shard_bits;
+  static constexpr size_t chunk_bits = 12;
+  static constexpr size_t chunk_size = 1 << chunk_bits;
+  static constexpr size_t max_chunks = 1 << 14;
+
+  struct Key
+  {
+    const char * data;
+    size_t length;
+    size_t hash;
+  };
+
+  struct KeyHash
+  {
+    size_t operator () (const Key & key) const { return key.hash; }
+  };
+
+  struct KeyEqual
+  {
+    bool operator () (const Key & lhs, const Key & rhs) const;
+  };
+
+  struct Shard
+  {
+    mutable std::mutex mutex;
+    std::unordered_map<Key, AlleleId, KeyHash, KeyEqual> ids;
+    // fixed table of chunk pointers, so lookups never see it reallocate
+    std::unique_ptr<std::atomic<ShortString *>[]> chunks;
+    size_t count = 0;
+  };
+
+  static size_t hash(const char * data, size_t length);
+
+  Shard shards[shard_count];
+};
+
+/**
+ * Allele held by a set, either the 32-bit id of an interned allele or a copy the
+ * entry owns and releases with the set. Both share one tagged word, so an entry
+ * stays as small as a pointer.
+ */
+class AlleleEntry
+{
+public:
+  static constexpr size_t max_interned_length = ShortString::inline_capacity;
+
+  /**
+   * Entry owning a copy of the allele.
+   */
+  AlleleEntry(const char * data, size_t length);
+  AlleleEntry(const AlleleEntry & other);
+  AlleleEntry(AlleleEntry && other) noexcept;
+  ~AlleleEntry();
+
+  AlleleEntry & operator = (const AlleleEntry & other);
+  AlleleEntry & operator = (AlleleEntry && other) noexcept;
+
+  /**
+   * Entry of an allele of a VCF record, interned in the global dictionary when it
+   * has at most max_interned_length bases.
+   */
+  static AlleleEntry interned(const char * data, size_t length);
+
+  bool is_interned() const;
+
+  /**
+   * Id in the global dictionary, only for an interned allele.
+   */
+  AlleleId id() const;
+
+  const char * data() const;
+  size_t length() const;
+  std::string str() const;
+
+  int compare(const char * other, size_t other_length) const;
+private:
+  AlleleEntry() = default;
+
+  void assign(const char * data, size_t length);
+  void release();
+
+  // interned: id << 1 | 1, owned: pointer to the length followed by the bases
+  uintptr_t bits;
+};
+
+/**
+ * Sorted set of alleles without duplicates, ordered by allele sequence. Most sites
+ * have one to three alternatives, those live entirely inside the set.
+ */
+class AlleleSet
+{
+  using Storage = SmallVector<AlleleEntry, 4>;
+public:
+  using const_iterator = Storage::const_iterator;
+
+  bool insert(const std::string & allele);
+  bool insert(const char * data, size_t length);
+  template<class InputIt>
+  void insert(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+
+  /**
+   * Inserts alleles of a VCF record, see AlleleEntry::interned.
+   */
+  bool intern(const std::string & allele);
+  template<class InputIt>
+  void intern(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first)
+      intern(*first);
+  }
+
+  /**
+   * Replaces the content by the strings of a range already sorted and without
+   * duplicates, without searching for the place of each.
+   */
+  template<class ForwardIt>
+  void assign_sorted(ForwardIt first, ForwardIt last)
+  {
+    alleles.clear();
+    alleles.reserve(std::distance(first, last));
+    for (; first != last; ++first)
+      alleles.push_back(AlleleEntry(first->data(), first->length()));
+  }
+
+  size_t count(const std::string & allele) const;
+  size_t erase(const std::string & allele);
+
+  const_iterator begin() const;
+  const_iterator end() const;
+  size_t size() const;
+  bool empty() const;
+
+  void swap(AlleleSet & other);
+private:
+  Storage::const_iterator lower_bound(const char * data, size_t length) const;
+  bool insert(const char * data, size_t length, bool interned);
+
+  Storage alleles;
+};
+
+#endif //VCF2EDS_ALLELE_H
@@ -0,0 +1,167 @@
+#include "bgzf_stream.h"
+
+#include <cstdio>
+
+namespace
+{
+  constexpr size_t read_chunk = 64 * 1024;
+}
+
+BgzfStreambuf::~BgzfStreambuf()
+{
+  close();
+}
+
+bool BgzfStreambuf::open(const std::string & filename, const char * mode, hts_tpool * pool)
+{
+  if (file)
+    return false;
+
+  file = bgzf_open(filename.c_str(), mode);
+  if (!file)
+    return false;
+
+  this->filename = filename;
+  uncompressed_offset = 0;
+  index_loaded = false;
+  if (pool)
+    bgzf_thread_pool(file, pool, 0);
+  if (mode[0] == 'w' && bgzf_index_build_init(file) != 0)
+  {
+    bgzf_close(file);
+    file = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+bool BgzfStreambuf::close()
+{
+  if (!file)
+    return true;
+
+  bool success = true;
+  if (file->is_write)
+    success = bgzf_flush(file) == 0 && bgzf_index_dump(file, filename.c_str(), ".gzi") == 0;
+  success = bgzf_close(file) == 0 && success;
+  file = nullptr;
+  return success;
+}
+
+bool BgzfStreambuf::is_open() const
+{
+  return file;
+}
+
+int64_t BgzfStreambuf::tell()
+{
+  return uncompressed_offset - (egptr() - gptr());
+}
+
+std::streamsize BgzfStreambuf::xsputn(const char * data, std::streamsize count)
+{
+  if (!file || bgzf_write(file, data, count) != count)
+    return 0;
+  uncompressed_offset += count;
+  return count;
+}
+
+BgzfStreambuf::int_type BgzfStreambuf::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+
+  char value = traits_type::to_char_type(c);
+  return xsputn(&value, 1) == 1 ? c : traits_type::eof();
+}
+
+BgzfStreambuf::int_type BgzfStreambuf::underflow()
+{
+  if (!file)
+    return traits_type::eof();
+
+  input_buffer.resize(read_chunk);
+  ssize_t count = bgzf_read(file, input_buffer.data(), input_buffer.size());
+  if (count <= 0)
+    return traits_type::eof();
+
+  uncompressed_offset += count;
+  setg(input_buffer.data(), input_buffer.data(), input_buffer.data() + count);
+  return traits_type::to_int_type(input_buffer[0]);
+}
+
+int BgzfStreambuf::sync()
+{
+  if (!file)
+    return -1;
+
+  return !file->is_write || bgzf_flush(file) == 0 ? 0 : -1;
+}
+
+BgzfStreambuf::pos_type BgzfStreambuf::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                               std::ios_base::openmode)
+{
+  // only the current position is reported
+  if (!file || offset != 0 || direction != std::ios_base::cur)
+    return pos_type(off_type(-1));
+
+  return pos_type(tell());
+}
+
+BgzfStreambuf::pos_type BgzfStreambuf::seekpos(pos_type position, std::ios_base::openmode)
+{
+  if (!file || file->is_write)
+    return pos_type(off_type(-1));
+
+  // bgzf_useek maps the offset to its block through the index, plain files need none
+  if (file->is_compressed && !index_loaded)
+  {
+    if (bgzf_index_load(file, filename.c_str(), ".gzi") != 0)
+      return pos_type(off_type(-1));
+    index_loaded = true;
+  }
+
+  if (bgzf_useek(file, static_cast<off_t>(position), SEEK_SET) < 0)
+    return pos_type(off_type(-1));
+
+  uncompressed_offset = position;
+  setg(nullptr, nullptr, nullptr);
+  return position;
+}
+
+BgzfOutputStream::BgzfOutputStream(const std::string & filename, hts_tpool * pool)
+  : ClosableOutputStream(&buffer)
+{
+  if (!buffer.open(filename, "w", pool))
+    setstate(std::ios::failbit);
+}
+
+bool BgzfOutputStream::is_open() const
+{
+  return buffer.is_open();
+}
+
+int64_t BgzfOutputStream::tell()
+{
+  return buffer.tell();
+}
+
+bool BgzfOutputStream::close()
+{
+  if (!buffer.close())
+    setstate(std::ios::badbit);
+  return !fail();
+}
+
+BgzfInputStream::BgzfInputStream(const std::string & filename, hts_tpool * pool)
+  : std::istream(&buffer)
+{
+  if (!buffer.open(filename, "r", pool))
+    setstate(std::ios::failbit);
+}
+
+bool BgzfInputStream::is_open() const
+{
+  return buffer.is_open();
+}
@@ -0,0 +1,102 @@
+#ifndef VCF2EDS_BGZF_STREAM_H
+#define VCF2EDS_BGZF_STREAM_H
+
+#include "file_stream.h"
+
+#include <htslib/bgzf.h>
+#include <htslib/thread_pool.h>
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * std::streambuf over a BGZF file. Writes go straight to bgzf_write, which fills
+ * 64 KiB blocks and hands them to the thread pool for compression when one is set.
+ */
+class BgzfStreambuf : public std::streambuf
+{
+public:
+  BgzfStreambuf() = default;
+  ~BgzfStreambuf() override;
+
+  BgzfStreambuf(const BgzfStreambuf &) = delete;
+  BgzfStreambuf & operator = (const BgzfStreambuf &) = delete;
+
+  /**
+   * mode as for bgzf_open, e.g. "r", "w" or "w6". Files opened for writing also
+   * build a .gzi index of the blocks, written by close.
+   */
+  bool open(const std::string & filename, const char * mode, hts_tpool * pool = nullptr);
+  bool close();
+  bool is_open() const;
+
+  /**
+   * Offset of the next byte in the uncompressed data. Counted here rather than taken
+   * from bgzf_tell, whose virtual offset lags behind once a thread pool compresses
+   * the blocks.
+   */
+  int64_t tell();
+protected:
+  std::streamsize xsputn(const char * data, std::streamsize count) override;
+  int_type overflow(int_type c) override;
+  int_type underflow() override;
+
+  /**
+   * Completes the current block of an output file with bgzf_flush.
+   */
+  int sync() override;
+
+  /**
+   * Positions are uncompressed offsets - tellp/tellg report tell(), seekg seeks with
+   * bgzf_useek through the .gzi index, loaded on the first seek in a compressed file.
+   */
+  pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type position, std::ios_base::openmode which) override;
+private:
+  BGZF * file = nullptr;
+  std::string filename;
+  std::vector<char> input_buffer;
+  // uncompressed offset following the bytes written, or read into input_buffer
+  int64_t uncompressed_offset = 0;
+  bool index_loaded = false;
+};
+
+/**
+ * Output stream block compressed with BGZF, seekable through the .gzi index written
+ * next to it and the uncompressed offsets reported by tell.
+ */
+class BgzfOutputStream : public ClosableOutputStream
+{
+public:
+  explicit BgzfOutputStream(const std::string & filename, hts_tpool * pool = nullptr);
+
+  bool is_open() const;
+  int64_t tell();
+
+  /**
+   * Flushes the last block, writes the index and the EOF marker block.
+   */
+  bool close() override;
+private:
+  BgzfStreambuf buffer;
+};
+
+/**
+ * Input stream decompressing BGZF, gzip or reading plain files as they are. BGZF files
+ * with a .gzi index and plain files can be seeked to uncompressed offsets.
+ */
+class BgzfInputStream : public std::istream
+{
+public:
+  explicit BgzfInputStream(const std::string & filename, hts_tpool * pool = nullptr);
+
+  bool is_open() const;
+private:
+  BgzfStreambuf buffer;
+};
+
+#endif //VCF2EDS_BGZF_STREAM_H
@@ -0,0 +1,86 @@
+#include "cluster_merger.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+ClusterMerger::ClusterMerger(std::unique_ptr<Segment> && first)
+  : first(std::move(first)),
+    start(this->first->start_position()),
+    end(this->first->end_position()),
+    reference(this->first->get_reference())
+{ }
+
+void ClusterMerger::add(const Segment & segment)
+{
+  if (segment.start_position() > end || segment.end_position() < start)
+    throw std::invalid_argument("Segment does not overlap the cluster");
+
+  // a segment sharing the start takes over the reference, let Segment::merge decide
+  if (segment.start_position() <= start)
+  {
+    auto cluster = finish();
+    cluster->merge(segment);
+    *this = ClusterMerger(std::move(cluster));
+    return;
+  }
+
+  if (!merged)
+  {
+    add_alleles(*first);
+    merged = true;
+  }
+  add_alleles(segment);
+
+  if (segment.end_position() > end)
+  {
+    const auto & suffix = segment.get_reference();
+    reference.append(suffix, suffix.length() - (segment.end_position() - end), std::string::npos);
+    end = segment.end_position();
+  }
+}
+
+void ClusterMerger::add_alleles(const Segment & segment)
+{
+  for (const auto & variant : segment.get_variants())
+    alleles.push_back(Allele{variant, segment.start_position(), segment.end_position()});
+}
+
+size_t ClusterMerger::start_position() const
+{
+  return start;
+}
+
+size_t ClusterMerger::end_position() const
+{
+  return end;
+}
+
+std::unique_ptr<Segment> ClusterMerger::finish()
+{
+  // nothing to pad, the segment keeps even alleles equal to its reference
+  if (!merged)
+    return std::move(first);
+
+  // pad everything first and build the set once, instead of a sorted insert per allele
+  std::vector<std::string> padded;
+  padded.reserve(alleles.size());
+  for (const auto & allele : alleles)
+  {
+    // reference before the allele window, the allele, reference after the window
+    std::string sequence;
+    sequence.reserve(reference.length() - (allele.end - allele.begin + 1) + allele.sequence.length());
+    sequence.append(reference, 0, allele.begin - start);
+    sequence.append(allele.sequence.data(), allele.sequence.length());
+    sequence.append(reference, allele.end - start + 1, std::string::npos);
+
+    if (sequence != reference)
+      padded.push_back(std::move(sequence));
+  }
+  std::sort(padded.begin(), padded.end());
+  padded.erase(std::unique(padded.begin(), padded.end()), padded.end());
+
+  auto cluster = std::make_unique<Segment>(start);
+  cluster->assign_variants(padded.begin(), padded.end());
+  cluster->add_reference(reference);
+  return cluster;
+}
@@ -0,0 +1,57 @@
+#ifndef VCF2EDS_CLUSTER_MERGER_H
+#define VCF2EDS_CLUSTER_MERGER_H
+
+#include "allele.h"
+#include "eds.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Merges an overlap cluster in one pass. The cluster reference is extended as segments
+ * are added and every allele is written into its padded form once, in finish. The result
+ * is the same as merging the segments pairwise with Segment::merge in the order they
+ * were added.
+ */
+class ClusterMerger
+{
+public:
+  explicit ClusterMerger(std::unique_ptr<Segment> && first);
+
+  /**
+   * Adds a segment overlapping the cluster. Segments are expected in order of their
+   * start positions, others are merged pairwise.
+   */
+  void add(const Segment & segment);
+
+  size_t start_position() const;
+  size_t end_position() const;
+
+  /**
+   * Returns the merged cluster, the merger must not be used afterwards.
+   */
+  std::unique_ptr<Segment> finish();
+private:
+  /**
+   * Allele of one of the added segments together with the window it replaces.
+   */
+  struct Allele
+  {
+    AlleleEntry sequence;
+    size_t begin;
+    size_t end;
+  };
+
+  void add_alleles(const Segment & segment);
+
+  std::unique_ptr<Segment> first;
+  size_t start = 0;
+  size_t end = 0;
+  std::string reference;
+  std::vector<Allele> alleles;
+  bool merged = false;
+};
+
+#endif //VCF2EDS_CLUSTER_MERGER_H
@@ -0,0 +1,427 @@
+#include "converter.h"
+#include "cluster_merger.h"
+#include "gap_merger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+bool add_variant(VariantMap & variants_pos, const VcfRecord & record)
+{
+  if (record.alt.empty() || record.alt[0][0] == '<')
+    return false;
+
+  std::unique_ptr<Segment> segment = std::make_unique<Segment>(record.position);
+  segment->add_reference(record.ref);
+  segment->intern_variants(begin(record.alt), end(record.alt));
+
+  auto segment_in_map = variants_pos.find(segment->start_position());
+  if (segment_in_map != variants_pos.end())
+  {
+    segment_in_map->second->merge(*segment);
+  }
+  else
+  {
+    variants_pos.insert(std::make_pair(segment->start_position(), std::move(segment)));
+  }
+
+  return true;
+}
+
+void append_cluster(const SegmentSink & sink, size_t & processed_pos, const ContigSequence & reference,
+                    std::unique_ptr<Segment> && cluster)
+{
+  // create segment of preceeding normal reference, its bases are read when it is written
+  size_t reference_end = std::min(cluster->start_position(), reference.length() + 1);
+  if (processed_pos < reference_end)
+    sink(std::make_unique<Segment>(processed_pos, reference, reference_end - processed_pos));
+
+  processed_pos = cluster->end_position() + 1;
+  sink(std::move(cluster));
+}
+
+void build_eds(VariantMap & variants_pos, const ContigSequence & reference, EDS & eds)
+{
+  build_eds(variants_pos, reference, [&eds](std::unique_ptr<Segment> && segment) { eds.add_segment(std::move(segment)); });
+}
+
+void build_eds(VariantMap & variants_pos, const ContigSequence & reference, const SegmentSink & sink)
+{
+  size_t processed_pos = 1;
+
+  // merge all overlapping segments in variants_pos
+  for (auto iter = variants_pos.begin(); iter != variants_pos.end(); ++iter)
+  {
+    ClusterMerger cluster(std::move(iter->second));
+
+    // if any following segments overlap - merge
+    auto iter_tmp = iter;
+    while (++iter_tmp != variants_pos.end()
+            && iter_tmp->second->start_position() <= cluster.end_position())
+    {
+      cluster.add(*(iter_tmp->second));
+      iter = iter_tmp;
+    }
+
+    append_cluster(sink, processed_pos, reference, cluster.finish());
+  }
+
+  variants_pos.clear();
+}
+
+std::string Region::to_string() const
+{
+  // "contig:begin" runs to the end of the contig
+  if (end == std::numeric_limits<size_t>::max())
+    return contig + ":" + std::to_string(begin);
+  return contig + ":" + std::to_string(begin) + "-" + std::to_string(end);
+}
+
+Region Region::parse(const std::string & text)
+{
+  // contig names may contain ':' themselves, the coordinates follow the last one
+  auto colon = text.rfind(':');
+  if (colon == std::string::npos || colon + 1 == text.length() ||
+      text.find_first_not_of("0123456789,-", colon + 1) != std::string::npos)
+    return Region{text, 1, std::numeric_limits<size_t>::max()};
+
+  std::string coordinates;
+  for (size_t i = colon + 1; i < text.length(); ++i)
+  {
+    if (text[i] != ',')
+      coordinates += text[i];
+  }
+
+  Region region{text.substr(0, colon), 0, std::numeric_limits<size_t>::max()};
+  try
+  {
+    auto dash = coordinates.find('-');
+    region.begin = std::stoull(coordinates.substr(0, dash));
+    if (dash != std::string::npos && dash + 1 < coordinates.length())
+      region.end = std::stoull(coordinates.substr(dash + 1));
+  }
+  catch (const std::logic_error &)
+  {
+    throw std::invalid_argument("Invalid region " + text);
+  }
+
+  if (region.begin == 0 || region.end < region.begin)
+    throw std::invalid_argument("Invalid region " + text);
+  return region;
+}
+
+ContigConverter::ContigConverter(const std::vector<std::string> & vcf_files, const Reference & reference,
+                                 hts_tpool * pool, int shards)
+  : vcf_files(vcf_files), reference(reference), pool(pool), shards(std::max(shards, 1))
+{ }
+
+void ContigConverter::set_gap_merging(size_t max_gap, size_t max_growth)
+{
+  merge_gaps = true;
+  this->max_gap = max_gap;
+  this->max_growth = max_growth;
+}
+
+size_t ContigConverter::saved_segments() const
+{
+  return saved;
+}
+
+std::vector<std::string> ContigConverter::contigs() const
+{
+  std::vector<std::string> result;
+  for (const auto & vcf_filename : vcf_files)
+  {
+    HtslibReader vcf_file(vcf_filename);
+    if (!vcf_file.is_open())
+      throw std::runtime_error("Could not open given VCF file: " + vcf_filename);
+
+    for (auto & contig : vcf_file.index_contigs())
+    {
+      if (std::find(result.begin(), result.end(), contig) == result.end())
+        result.push_back(std::move(contig));
+    }
+  }
+
+  return result;
+}
+
+std::vector<Region> ContigConverter::plan_shards(const std::string & contig) const
+{
+  const ContigSequence * sequence = reference.find(contig);
+  if (!sequence)
+    throw std::runtime_error("Contig " + contig + " is missing in the reference");
+
+  // the last region is open ended, build_eds keeps variants past the end of the
+  // reference as well
+  const size_t unbounded = std::numeric_limits<size_t>::max();
+  size_t length = std::max<size_t>(sequence->length(), 1);
+  if (shards == 1)
+    return {Region{contig, 1, unbounded}};
+
+  // weigh fine windows by the index, then group them into shards of similar weight
+  size_t windows = std::min<size_t>(static_cast<size_t>(shards) * 16, length);
+  std::vector<size_t> window_end(windows);
+  std::vector<uint64_t> window_weight(windows, 0);
+  for (size_t i = 0; i < windows; ++i)
+    window_end[i] = length * (i + 1) / windows;
+
+  for (const auto & vcf_filename : vcf_files)
+  {
+    HtslibReader vcf_file(vcf_filename);
+    if (!vcf_file.is_open())
+      throw std::runtime_error("Could not open given VCF file: " + vcf_filename);
+
+    size_t begin = 1;
+    for (size_t i = 0; i < windows; ++i)
+    {
+      window_weight[i] += vcf_file.region_weight(contig, begin, window_end[i]);
+      begin = window_end[i] + 1;
+    }
+  }
+
+  uint64_t total_weight = 0;
+  for (auto weight : window_weight)
+    total_weight += weight;
+
+  // nothing indexed for the contig - fall back to even widths
+  if (total_weight == 0)
+  {
+    std::fill(window_weight.begin(), window_weight.end(), 1);
+    total_weight = windows;
+  }
+
+  std::vector<Region> regions;
+  size_t begin = 1;
+  uint64_t accumulated = 0;
+  for (size_t i = 0; i < windows; ++i)
+  {
+    accumulated += window_weight[i];
+    bool last = i + 1 == windows;
+    if (last || (regions.size() + 1 < static_cast<size_t>(shards)
+                 && accumulated * shards >= total_weight * (regions.size() + 1)))
+    {
+      regions.push_back(Region{contig, begin, last ? unbounded : window_end[i]});
+      begin = window_end[i] + 1;
+    }
+  }
+
+  return regions;
+}
+
+ClusterList ContigConverter::build_shard(const Region & region) const
+{
+  VariantMap variants_pos;
+  for (const auto & vcf_filename : vcf_files)
+  {
+    HtslibReader vcf_file(vcf_filename, pool);
+    if (!vcf_file.is_open())
+      throw std::runtime_error("Could not open given VCF file: " + vcf_filename);
+
+    VcfRecord record;
+    if (!vcf_file.set_region(region.to_string()))
+      continue;
+    while (vcf_file.next(record))
+    {
+      // the query also returns records overlapping the region from the left,
+      // those belong to the preceding shard
+      if (record.position >= region.begin && record.position <= region.end)
+        add_variant(variants_pos, record);
+    }
+  }
+
+  ClusterList clusters;
+  for (auto iter = variants_pos.begin(); iter != variants_pos.end(); ++iter)
+  {
+    Cluster cluster;
+    auto segment_ptr = std::move(iter->second);
+
+    auto iter_tmp = std::next(iter);
+    if (iter_tmp != variants_pos.end() && iter_tmp->second->start_position() <= segment_ptr->end_position())
+      cluster.variants.push_back(std::make_unique<Segment>(*segment_ptr));
+
+    ClusterMerger merger(std::move(segment_ptr));
+    for (; iter_tmp != variants_pos.end() && iter_tmp->second->start_position() <= merger.end_position(); ++iter_tmp)
+    {
+      merger.add(*(iter_tmp->second));
+      cluster.variants.push_back(std::move(iter_tmp->second));
+      iter = iter_tmp;
+    }
+
+    cluster.merged = merger.finish();
+    clusters.push_back(std::move(cluster));
+  }
+
+  return clusters;
+}
+
+EDS ContigConverter::stitch(const std::string & contig, std::vector<ClusterList> & shard_clusters) const
+{
+  const ContigSequence * sequence = reference.find(contig);
+  if (!sequence)
+    throw std::runtime_error("Contig " + contig + " is missing in the reference");
+
+  EDS eds;
+  eds.set_contig(contig);
+  size_t processed_pos = 1;
+  SegmentSink sink = [&eds](std::unique_ptr<Segment> && segment) { eds.add_segment(std::move(segment)); };
+  std::unique_ptr<GapMerger> gaps;
+  if (merge_gaps)
+  {
+    gaps = std::make_unique<GapMerger>(max_gap, max_growth, std::move(sink));
+    sink = [&gaps](std::unique_ptr<Segment> && segment) { gaps->add(std::move(segment)); };
+  }
+  std::unique_ptr<ClusterMerger> open_cluster;
+
+  for (auto & clusters : shard_clusters)
+  {
+    for (auto & cluster : clusters)
+    {
+      if (open_cluster && cluster.merged->start_position() <= open_cluster->end_position())
+      {
+        // crosses the shard boundary - continue the serial merge variant by variant
+        if (cluster.variants.empty())
+        {
+          open_cluster->add(*cluster.merged);
+        }
+        else
+        {
+          for (const auto & variant : cluster.variants)
+            open_cluster->add(*variant);
+        }
+        continue;
+      }
+
+      if (open_cluster)
+        append_cluster(sink, processed_pos, *sequence, open_cluster->finish());
+      open_cluster = std::make_unique<ClusterMerger>(std::move(cluster.merged));
+    }
+
+    clusters.clear();
+  }
+
+  if (open_cluster)
+    append_cluster(sink, processed_pos, *sequence, open_cluster->finish());
+
+  if (gaps)
+  {
+    gaps->finish();
+    saved += gaps->saved_segments();
+  }
+
+  return eds;
+}
+
+EDS ContigConverter::convert(const std::string & contig) const
+{
+  auto regions = plan_shards(contig);
+
+  std::vector<ClusterList> shard_clusters;
+  for (const auto & region : regions)
+    shard_clusters.push_back(build_shard(region));
+
+  return stitch(contig, shard_clusters);
+}
+
+void ContigConverter::run(const std::vector<std::string> & contigs, int jobs, const CommitCallback & commit) const
+{
+  // every shard of every contig is one task, the worker finishing the last
+  // shard of a contig stitches it
+  struct ContigTask
+  {
+    std::vector<Region> regions;
+    std::vector<ClusterList> shard_clusters;
+    std::atomic<size_t> remaining;
+  };
+
+  std::vector<ContigTask> contig_tasks(contigs.size());
+  std::vector<std::pair<size_t, size_t>> tasks;
+  for (size_t idx = 0; idx < contigs.size(); ++idx)
+  {
+    auto & contig_task = contig_tasks[idx];
+    contig_task.regions = plan_shards(contigs[idx]);
+    contig_task.shard_clusters.resize(contig_task.regions.size());
+    contig_task.remaining = contig_task.regions.size();
+    for (size_t shard = 0; shard < contig_task.regions.size(); ++shard)
+      tasks.push_back(std::make_pair(idx, shard));
+  }
+
+  std::vector<EDS> results(contigs.size());
+  std::vector<bool> finished(contigs.size(), false);
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable cond_finished;
+  std::atomic<size_t> next_task(0);
+
+  auto worker = [&]()
+  {
+    size_t task;
+    while ((task = next_task++) < tasks.size())
+    {
+      size_t idx = tasks[task].first;
+      auto & contig_task = contig_tasks[idx];
+      try
+      {
+        contig_task.shard_clusters[tasks[task].second] = build_shard(contig_task.regions[tasks[task].second]);
+        if (--contig_task.remaining > 0)
+          continue;
+
+        EDS eds = stitch(contigs[idx], contig_task.shard_clusters);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results[idx] = std::move(eds);
+        finished[idx] = true;
+        cond_finished.notify_all();
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+          error = std::current_exception();
+        next_task = tasks.size();
+        cond_finished.notify_all();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::max(jobs, 1); ++i)
+    workers.emplace_back(worker);
+
+  // commit finished contigs in order while the rest is still converting
+  for (size_t idx = 0; idx < contigs.size(); ++idx)
+  {
+    EDS eds;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond_finished.wait(lock, [&]() { return finished[idx] || error; });
+      if (error)
+        break;
+      eds = std::move(results[idx]);
+    }
+
+    try
+    {
+      commit(contigs[idx], std::move(eds));
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      error = std::current_exception();
+      next_task = tasks.size();
+      break;
+    }
+  }
+
+  for (auto & thread : workers)
+    thread.join();
+
+  if (error)
+    std::rethrow_exception(error);
+}
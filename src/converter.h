@@ -0,0 +1,132 @@
+#ifndef VCF2EDS_CONVERTER_H
+#define VCF2EDS_CONVERTER_H
+
+#include "eds.h"
+#include "reference.h"
+#include "vcf_reader.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using VariantMap = std::map<size_t, std::unique_ptr<Segment>>;
+using SegmentSink = std::function<void(std::unique_ptr<Segment> && segment)>;
+
+/**
+ * Inserts a VCF record into the map, merging it with a record at the same position.
+ * Records without alternatives or with symbolic alleles are skipped and false is returned.
+ */
+bool add_variant(VariantMap & variants_pos, const VcfRecord & record);
+
+/**
+ * Merges overlapping variants and interleaves them with the reference segments between them.
+ * The map is consumed.
+ */
+void build_eds(VariantMap & variants_pos, const ContigSequence & reference, EDS & eds);
+void build_eds(VariantMap & variants_pos, const ContigSequence & reference, const SegmentSink & sink);
+
+/**
+ * Passes the reference preceding the cluster and the cluster itself to the sink.
+ * processed_pos is the first reference position not emitted yet.
+ */
+void append_cluster(const SegmentSink & sink, size_t & processed_pos, const ContigSequence & reference,
+                    std::unique_ptr<Segment> && cluster);
+
+/**
+ * Part of a contig, 1-based and inclusive. An end of std::numeric_limits<size_t>::max()
+ * runs to the end of the contig.
+ */
+struct Region
+{
+  std::string contig;
+  size_t begin;
+  size_t end;
+
+  std::string to_string() const;
+
+  /**
+   * Parses "contig", "contig:begin" or "contig:begin-end", throws std::invalid_argument.
+   */
+  static Region parse(const std::string & text);
+};
+
+/**
+ * Overlap cluster built inside one shard. When the cluster consists of more than one
+ * variant, the unmerged variants are kept so that a cluster of the preceding shard
+ * can absorb them in the same order as the serial merge would.
+ */
+struct Cluster
+{
+  std::unique_ptr<Segment> merged;
+  std::vector<std::unique_ptr<Segment>> variants;
+};
+
+using ClusterList = std::vector<Cluster>;
+
+/**
+ * Converts contigs of indexed VCF/BCF files independently on a pool of worker threads.
+ */
+class ContigConverter
+{
+public:
+  using CommitCallback = std::function<void(const std::string & contig, EDS && eds)>;
+
+  ContigConverter(const std::vector<std::string> & vcf_files, const Reference & reference,
+                  hts_tpool * pool = nullptr, int shards = 1);
+
+  /**
+   * Joins degenerate segments separated by at most max_gap bases, see GapMerger.
+   */
+  void set_gap_merging(size_t max_gap, size_t max_growth);
+  size_t saved_segments() const;
+
+  /**
+   * Contigs present in any of the VCF indexes, in order of first appearance.
+   */
+  std::vector<std::string> contigs() const;
+
+  /**
+   * Converts the given contigs using jobs threads. commit is called from the calling
+   * thread once per contig, in the order of contigs, as soon as the contig is finished.
+   */
+  void run(const std::vector<std::string> & contigs, int jobs, const CommitCallback & commit) const;
+
+  /**
+   * Converts one contig in the calling thread.
+   */
+  EDS convert(const std::string & contig) const;
+
+  /**
+   * Splits the contig into at most shards regions holding roughly the same amount of
+   * variant data, as estimated from the index. The last region is open ended, so
+   * records past the end of the reference are kept as by build_eds.
+   */
+  std::vector<Region> plan_shards(const std::string & contig) const;
+
+  /**
+   * Builds overlap clusters of variants starting inside the region.
+   */
+  ClusterList build_shard(const Region & region) const;
+
+  /**
+   * Joins clusters of consecutive shards, re-merging clusters that cross shard
+   * boundaries, and fills the gaps with reference. The output is identical to build_eds.
+   */
+  EDS stitch(const std::string & contig, std::vector<ClusterList> & shards) const;
+private:
+  const std::vector<std::string> & vcf_files;
+  const Reference & reference;
+  hts_tpool * pool;
+  int shards;
+
+  bool merge_gaps = false;
+  size_t max_gap = 0;
+  size_t max_growth = 0;
+  mutable std::atomic<size_t> saved{0};
+};
+
+#endif //VCF2EDS_CONVERTER_H
@@ -1,12 +1,53 @@
 #include "eds.h"
+#include "bgzf_stream.h"
+#include "eds_format.h"
+#include "eds_index.h"
+#include "eds_parser.h"
+#include "eds_writer.h"
+#include "reference.h"
 
-#include <unordered_set>
 #include <vector>
 #include <cassert>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <thread>
 #include <htslib/hts.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  // bytes of output per range formatted by one thread in a parallel save
+  constexpr size_t save_chunk = 4 << 20;
+  constexpr size_t save_writer_buffer = 64 * 1024;
+  // bytes of a binary payload read at once, bounds what a corrupt size can allocate
+  constexpr size_t load_chunk = 16 << 20;
+
+  /**
+   * Read-only stream buffer over characters in memory.
+   */
+  class MemoryStreambuf : public std::streambuf
+  {
+  public:
+    MemoryStreambuf(const char * data, size_t length)
+    {
+      char * begin = const_cast<char *>(data);
+      setg(begin, begin, begin + length);
+    }
+  };
+}
+
 std::ostream & operator << (std::ostream & os, const EDS & eds)
 {
   eds.save(os);
@@ -24,10 +65,17 @@ std::ostream & operator << (std::ostream & os, const Segment & segment)
   if (segment.is_degenerate())
   {
     os << "{" << segment.reference;
-    for (const auto & s : segment.variants)
-      os << "," << s;
+    for (const auto & variant : segment.variants)
+    {
+      os << ",";
+      os.write(variant.data(), variant.length());
+    }
     os << "}";
   }
+  else if (segment.source)
+  {
+    segment.source->write(os, segment.position - 1, segment.span_length);
+  }
   else
   {
     os << segment.reference;
@@ -44,6 +92,10 @@ Segment::Segment(size_t position, std::string && reference)
   : position(position), reference(std::move(reference))
 { }
 
+Segment::Segment(size_t position, const ContigSequence & source, size_t length)
+  : position(position), source(&source), span_length(length)
+{ }
+
 void Segment::add_reference(const std::string & ref)
 {
   reference = ref;
@@ -61,12 +113,12 @@ size_t Segment::start_position() const
 
 size_t Segment::end_position() const
 {
-  return position + reference.length() - 1;
+  return position + length() - 1;
 }
 
 size_t Segment::length() const
 {
-  return reference.length();
+  return source ? span_length : reference.length();
 }
 
 bool Segment::is_degenerate() const
@@ -74,6 +126,21 @@ bool Segment::is_degenerate() const
   return !variants.empty();
 }
 
+const std::string & Segment::get_reference() const
+{
+  return reference;
+}
+
+const Segment::VariantListType & Segment::get_variants() const
+{
+  return variants;
+}
+
+const ContigSequence * Segment::get_source() const
+{
+  return source;
+}
+
 void Segment::merge(const Segment & segment)
 {
   if (end_position() < segment.start_position() || segment.end_position() < start_position())
@@ -160,8 +227,14 @@ void Segment::merge(const Segment & segment)
   }
 
   // generate new variants
-  std::vector<std::string> copy_variants1(variants.begin(), variants.end());
-  std::vector<std::string> copy_variants2(segment.variants.begin(), segment.variants.end());
+  std::vector<std::string> copy_variants1;
+  std::vector<std::string> copy_variants2;
+  copy_variants1.reserve(variants.size());
+  copy_variants2.reserve(segment.variants.size());
+  for (const auto & variant : variants)
+    copy_variants1.push_back(variant.str());
+  for (const auto & variant : segment.variants)
+    copy_variants2.push_back(variant.str());
   if (prefix.length() > 0) // musime vsechny prvky z mnoziny rozsirit o prefix
   {
     if (prefix_id == 1)
@@ -193,7 +266,7 @@ void Segment::merge(const Segment & segment)
   }
 
   reference = new_reference;
-  std::unordered_set<std::string> new_variants;
+  VariantListType new_variants;
   std::for_each(copy_variants1.begin(), copy_variants1.end(), [&](const auto & variant){ new_variants.insert(variant); });
   std::for_each(copy_variants2.begin(), copy_variants2.end(), [&](const auto & variant){ new_variants.insert(variant); });
 
@@ -203,73 +276,689 @@ void Segment::merge(const Segment & segment)
   variants.swap(new_variants);
 }
 
+std::string StringRef::str() const
+{
+  return std::string(data, length);
+}
+
+std::ostream & operator << (std::ostream & os, const StringRef & string)
+{
+  return os.write(string.data, string.length);
+}
+
+std::ostream & operator << (std::ostream & os, const SegmentView & segment)
+{
+  if (segment.is_degenerate())
+  {
+    os << "{" << segment.reference();
+    for (size_t i = 0; i < segment.variant_count(); ++i)
+      os << "," << segment.variant(i);
+    os << "}";
+  }
+  else
+  {
+    segment.write_reference(os);
+  }
+
+  return os;
+}
+
+SegmentView::SegmentView(const EDS & eds, size_t idx)
+  : eds(eds), idx(idx)
+{ }
+
+size_t SegmentView::start_position() const
+{
+  return eds.positions[idx];
+}
+
+size_t SegmentView::end_position() const
+{
+  return start_position() + length() - 1;
+}
+
+size_t SegmentView::length() const
+{
+  return eds.reference_lengths[idx];
+}
+
+bool SegmentView::is_degenerate() const
+{
+  return variant_count() > 0;
+}
+
+bool SegmentView::is_span() const
+{
+  return eds.reference_offsets[idx] == EDS::span_offset;
+}
+
+StringRef SegmentView::reference() const
+{
+  if (is_span())
+    throw std::logic_error("Reference of a span segment is not held by the EDS");
+
+  return StringRef{eds.arena.data() + eds.reference_offsets[idx], length()};
+}
+
+void SegmentView::write_reference(std::ostream & os) const
+{
+  if (is_span())
+    eds.source->write(os, start_position() - 1, length());
+  else
+    os << reference();
+}
+
+void SegmentView::write_reference(EdsWriter & writer) const
+{
+  if (is_span())
+    writer.write_reference(*eds.source, start_position() - 1, length());
+  else
+    writer.write(reference());
+}
+
+size_t SegmentView::variant_count() const
+{
+  return eds.variant_begin[idx + 1] - eds.variant_begin[idx];
+}
+
+StringRef SegmentView::variant(size_t variant_idx) const
+{
+  return eds.variant_string(eds.variants[eds.variant_begin[idx] + variant_idx]);
+}
+
+EDS::const_iterator::const_iterator(const EDS & eds, size_t idx)
+  : eds(eds), idx(idx)
+{ }
+
+SegmentView EDS::const_iterator::operator * () const
+{
+  return SegmentView(eds, idx);
+}
+
+EDS::const_iterator & EDS::const_iterator::operator ++ ()
+{
+  ++idx;
+  return *this;
+}
+
+bool EDS::const_iterator::operator != (const const_iterator & other) const
+{
+  return idx != other.idx;
+}
+
+constexpr size_t EDS::span_offset;
+
+void EDS::add_reference(const char * data, size_t length)
+{
+  reference_offsets.push_back(arena.length());
+  reference_lengths.push_back(length);
+  arena.append(data, length);
+}
+
+void EDS::add_span(size_t length)
+{
+  reference_offsets.push_back(span_offset);
+  reference_lengths.push_back(length);
+}
+
+constexpr uint64_t EDS::arena_variant;
+
+void EDS::add_variant(const char * data, size_t length)
+{
+  variants.push_back(arena_variant | arena.length());
+  uint32_t stored_length = static_cast<uint32_t>(length);
+  arena.append(reinterpret_cast<const char *>(&stored_length), sizeof(stored_length));
+  arena.append(data, length);
+}
+
+void EDS::add_variant(const AlleleEntry & variant)
+{
+  if (variant.is_interned())
+    variants.push_back(variant.id());
+  else
+    add_variant(variant.data(), variant.length());
+}
+
+StringRef EDS::variant_string(uint64_t variant) const
+{
+  if ((variant & arena_variant) == 0)
+  {
+    const auto & allele = AlleleDictionary::global().get(static_cast<AlleleId>(variant));
+    return StringRef{allele.data(), allele.length()};
+  }
+
+  const char * stored = arena.data() + (variant & ~arena_variant);
+  uint32_t length;
+  std::memcpy(&length, stored, sizeof(length));
+  return StringRef{stored + sizeof(length), length};
+}
+
+void EDS::close_segment(size_t position)
+{
+  // alternatives read from files come in any order, keep them sorted by sequence as in
+  // AlleleSet so that the output does not depend on the input order
+  auto compare = [this](uint64_t lhs, uint64_t rhs)
+  {
+    auto left = variant_string(lhs);
+    auto right = variant_string(rhs);
+    int result = std::memcmp(left.data, right.data, std::min(left.length, right.length));
+    return result != 0 ? result : (left.length < right.length ? -1 : (left.length > right.length ? 1 : 0));
+  };
+  auto less = [&compare](uint64_t lhs, uint64_t rhs) { return compare(lhs, rhs) < 0; };
+  auto equal = [&compare](uint64_t lhs, uint64_t rhs) { return lhs == rhs || compare(lhs, rhs) == 0; };
+
+  auto first = variants.begin() + variant_begin.back();
+  if (!std::is_sorted(first, variants.end(), less))
+    std::sort(first, variants.end(), less);
+  variants.erase(std::unique(first, variants.end(), equal), variants.end());
+
+  positions.push_back(position);
+  variant_begin.push_back(variants.size());
+}
+
 void EDS::add_segment(std::unique_ptr<Segment> && segment_ptr)
 {
-  segments.push_back(std::move(segment_ptr));
+  add_segment(*segment_ptr);
 }
 
-void EDS::save(std::ostream & os) const
+void EDS::add_segment(const Segment & segment)
 {
-  for (const auto & segment : segments)
+  const ContigSequence * segment_source = segment.get_source();
+  if (segment_source && (!source || source == segment_source))
   {
-    os << *segment;
+    // an EDS describes one contig, all its spans share the source
+    source = segment_source;
+    add_span(segment.length());
+    close_segment(segment.start_position());
+    return;
   }
+
+  if (segment_source)
+  {
+    std::string reference = segment_source->fetch(segment.start_position() - 1, segment.length());
+    add_reference(reference.data(), reference.length());
+    close_segment(segment.start_position());
+    return;
+  }
+
+  add_reference(segment.get_reference().data(), segment.get_reference().length());
+  for (const auto & variant : segment.get_variants())
+    add_variant(variant);
+  close_segment(segment.start_position());
+}
+
+EDS::Format EDS::parse_format(const std::string & name)
+{
+  if (name == "text")
+    return Format::text;
+  if (name == "binary")
+    return Format::binary;
+
+  throw std::invalid_argument("Unknown EDS format " + name);
+}
+
+void EDS::set_contig(const std::string & name)
+{
+  contig_name = name;
+}
+
+const std::string & EDS::contig() const
+{
+  return contig_name;
+}
+
+size_t EDS::next_position() const
+{
+  return positions.empty() ? 1 : positions.back() + reference_lengths.back();
+}
+
+void EDS::save(std::ostream & os, Format format, EdsIndex * index, int threads) const
+{
+  if (index)
+    index->begin_contig(contig_name);
+
+  if (format == Format::binary)
+    save_binary_header(os);
+
+  if (threads > 1)
+    save_segments(os, format, index, threads);
+  else
+    save_segments(os, format, index);
 }
 
 void EDS::load(std::istream & is)
 {
-  std::string data((std::istreambuf_iterator<char>(is)),
-                  std::istreambuf_iterator<char>());
-  size_t current_pos = 0;
-  while (current_pos != std::string::npos && current_pos < data.length())
+  if (BinaryEdsHeader::detect(is))
+    load_binary(is);
+  else
+    load_text(is);
+}
+
+void EDS::save_binary_header(std::ostream & os) const
+{
+  BinaryEdsHeader header;
+  header.contig = contig_name;
+  header.segment_count = size();
+
+  // the offset table precedes the payload, size the segments first
+  std::string offsets;
+  offsets.reserve(8 * (size() + 1));
+  size_t offset = 0;
+  append_le64(offsets, offset);
+  for (size_t i = 0; i < size(); ++i)
   {
-    char peek = data[current_pos];
+    auto view = segment(i);
+    header.reference_length += view.length();
+    header.total_size += view.length();
+    header.max_alternatives = std::max<uint64_t>(header.max_alternatives, view.variant_count());
 
-    if (peek == '{')
+    offset += 8 + 4 + 4 + view.length();
+    for (size_t v = 0; v < view.variant_count(); ++v)
     {
-      current_pos += 1;
-      // parse {..., ..., ...}
-      std::unique_ptr<Segment> segment = std::make_unique<Segment>(current_pos + 1);
-      auto closing_bracket = data.find_first_of('}', current_pos);
-      auto pun = data.find_first_of(',', current_pos);
+      offset += 4 + view.variant(v).length;
+      header.total_size += view.variant(v).length;
+    }
+    append_le64(offsets, offset);
+  }
+  header.payload_size = offset;
+
+  header.write(os);
+  os.write(offsets.data(), offsets.length());
+}
+
+void EDS::save_segments(std::ostream & os, Format format, EdsIndex * index) const
+{
+  EdsWriter writer(os);
+  for (size_t i = 0; i < size(); ++i)
+  {
+    auto view = segment(i);
+    if (index)
+      index->add(writer, view);
+    if (format == Format::binary)
+      writer.write_binary(view);
+    else
+      writer.write_text(view);
+  }
+}
 
-      if (pun >= closing_bracket)
-        throw std::exception();
+void EDS::save_segments(std::ostream & os, Format format, EdsIndex * index, int threads) const
+{
+  // ranges of about save_chunk bytes, the estimate ignores the allele lengths
+  std::vector<size_t> bounds = {0};
+  size_t estimate = 0;
+  for (size_t i = 0; i < size(); ++i)
+  {
+    estimate += 16 + reference_lengths[i] + 8 * (variant_begin[i + 1] - variant_begin[i]);
+    if (estimate >= save_chunk && i + 1 < size())
+    {
+      bounds.push_back(i + 1);
+      estimate = 0;
+    }
+  }
+  bounds.push_back(size());
 
-      segment->add_reference(data.substr(current_pos, pun - current_pos));
-      current_pos = pun + 1;
+  // a range is formatted at most window ranges ahead of the one being written
+  struct Chunk
+  {
+    std::string data;
+    // offset of each segment in data, kept for the index
+    std::vector<size_t> offsets;
+    bool done = false;
+  };
+  std::vector<Chunk> chunks(bounds.size() - 1);
+  const size_t window = 2 * static_cast<size_t>(threads);
+  size_t committed = 0;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::atomic<size_t> next_chunk(0);
+
+  auto worker = [&]()
+  {
+    size_t chunk;
+    while ((chunk = next_chunk++) < chunks.size())
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return error || chunk < committed + window; });
+        if (error)
+          return;
+      }
 
-      while (current_pos < closing_bracket)
+      try
+      {
+        std::ostringstream stream;
+        std::vector<size_t> offsets;
+        {
+          EdsWriter writer(stream, save_writer_buffer);
+          for (size_t i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+          {
+            if (index)
+              offsets.push_back(writer.size());
+            if (format == Format::binary)
+              writer.write_binary(segment(i));
+            else
+              writer.write_text(segment(i));
+          }
+        }
+
+        std::string data = stream.str();
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks[chunk].data = std::move(data);
+        chunks[chunk].offsets = std::move(offsets);
+        chunks[chunk].done = true;
+        changed.notify_all();
+      }
+      catch (...)
       {
-        pun = data.find_first_of(',', current_pos);
-        pun = (pun >= closing_bracket) ? closing_bracket : pun;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+          error = std::current_exception();
+        changed.notify_all();
+      }
+    }
+  };
 
-        segment->add_variant(data.substr(current_pos, pun - current_pos));
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::min<int>(threads, chunks.size()); ++i)
+    workers.emplace_back(worker);
 
-        current_pos = pun + 1;
+  // ranges are written in order by this thread, the index sees the segments as in a
+  // serial save
+  for (size_t chunk = 0; chunk < chunks.size(); ++chunk)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return error || chunks[chunk].done; });
+      if (error)
+        break;
+    }
+
+    try
+    {
+      const auto & data = chunks[chunk].data;
+      size_t written = 0;
+      if (index)
+      {
+        for (size_t i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+        {
+          if (index->checkpoint_due(positions[i]))
+          {
+            size_t offset = chunks[chunk].offsets[i - bounds[chunk]];
+            os.write(data.data() + written, offset - written);
+            written = offset;
+            index->add_checkpoint(positions[i], EdsIndex::tell(os));
+          }
+          index->add_segment(positions[i], reference_lengths[i]);
+        }
       }
+      os.write(data.data() + written, data.length() - written);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+        error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string().swap(chunks[chunk].data);
+    std::vector<size_t>().swap(chunks[chunk].offsets);
+    committed = chunk + 1;
+    changed.notify_all();
+  }
+
+  for (auto & thread : workers)
+    thread.join();
 
-      segments.push_back(std::move(segment));
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void EDS::load_binary(std::istream & is)
+{
+  BinaryEdsHeader header;
+  std::string payload;
+  while (header.read(is))
+  {
+    if (contig_name.empty())
+      contig_name = header.contig;
+
+    // the counts size the reads and reservations below, each segment takes at least its
+    // u64 position, u32 number of alternatives and u32 reference length of the payload
+    if (header.segment_count > header.payload_size / 16 || header.reference_length > header.payload_size)
+      throw std::runtime_error("Invalid binary EDS header");
+
+    // the offset table serves random access only, the payload is read in order
+    uint64_t table_size = 8 * (header.segment_count + 1);
+    is.ignore(static_cast<std::streamsize>(table_size));
+    if (static_cast<uint64_t>(is.gcount()) != table_size)
+      throw std::runtime_error("Truncated binary EDS");
+
+    // grown as the bytes arrive, a payload size past the end of the stream fails as
+    // truncated instead of being allocated up front
+    payload.clear();
+    while (payload.length() < header.payload_size)
+    {
+      size_t offset = payload.length();
+      size_t chunk = std::min<uint64_t>(header.payload_size - offset, load_chunk);
+      payload.resize(offset + chunk);
+      is.read(&payload[offset], chunk);
+      if (static_cast<size_t>(is.gcount()) != chunk)
+        throw std::runtime_error("Truncated binary EDS");
     }
-    else
+
+    size_t segments = size() + header.segment_count;
+    positions.reserve(segments);
+    reference_offsets.reserve(segments);
+    reference_lengths.reserve(segments);
+    variant_begin.reserve(segments + 1);
+    arena.reserve(arena.length() + header.reference_length);
+
+    const char * data = payload.data();
+    const char * end = data + payload.length();
+    auto take_string = [&]()
     {
-      auto next_pos = data.find_first_of('{', current_pos);
-      if (next_pos == std::string::npos || current_pos < next_pos)
+      if (end - data < 4 || static_cast<size_t>(end - data - 4) < read_le32(data))
+        throw std::runtime_error("Malformed binary EDS segment");
+      StringRef string{data + 4, read_le32(data)};
+      data += 4 + string.length;
+      return string;
+    };
+
+    for (uint64_t i = 0; i < header.segment_count; ++i)
+    {
+      if (end - data < 12)
+        throw std::runtime_error("Malformed binary EDS segment");
+      size_t position = read_le64(data);
+      uint32_t alternatives = read_le32(data + 8);
+      data += 12;
+
+      auto reference = take_string();
+      add_reference(reference.data, reference.length);
+      for (uint32_t v = 0; v < alternatives; ++v)
       {
-        auto count = next_pos == std::string::npos ? std::string::npos : next_pos - current_pos;
+        auto variant = take_string();
+        add_variant(variant.data, variant.length);
+      }
+      close_segment(position);
+    }
+  }
+}
 
-        // create simple segment
-        segments.push_back(std::make_unique<Segment>(
-                current_pos + 1,
-                data.substr(current_pos, count)
-        ));
+void EDS::load_text(std::istream & is)
+{
+  // segments follow each other on the reference, each starts where the previous ended
+  EdsTextParser parser(is, next_position());
+  bool reference_run = false;
+  for (const auto & segment : parser)
+  {
+    if (reference_run && !segment.is_degenerate())
+    {
+      // the parser yields long reference runs in pieces, they stay one segment
+      arena.append(segment.reference.data, segment.reference.length);
+      reference_lengths.back() += segment.reference.length;
+      continue;
+    }
+
+    add_reference(segment.reference.data, segment.reference.length);
+    for (const auto & variant : segment.variants)
+      add_variant(variant.data, variant.length);
+    close_segment(segment.position);
+    reference_run = !segment.is_degenerate();
+  }
+}
+
+bool EDS::load_file(const std::string & filename, int threads, hts_tpool * pool)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  size_t length = info.st_size;
+  void * mapping = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  const char * data = static_cast<const char *>(mapping);
+  bool compressed = length >= 2 && data[0] == '\x1f' && data[1] == '\x8b';
+  if (length == 0 || threads <= 1 || compressed || data[0] == '\x89')
+  {
+    if (mapping)
+      munmap(mapping, length);
+
+    BgzfInputStream input(filename, pool);
+    if (!input.is_open())
+      return false;
+    load(input);
+    return true;
+  }
+
+  madvise(mapping, length, MADV_SEQUENTIAL);
+
+  // chunks end right before a '{', so no chunk splits a degenerate segment
+  size_t chunk_count = 4 * static_cast<size_t>(threads);
+  std::vector<size_t> bounds = {0};
+  for (size_t i = 1; i < chunk_count; ++i)
+  {
+    size_t bound = std::max(bounds.back(), length / chunk_count * i);
+    const char * brace = static_cast<const char *>(memchr(data + bound, '{', length - bound));
+    bound = brace ? brace - data : length;
+    if (bound > bounds.back() && bound < length)
+      bounds.push_back(bound);
+  }
+  bounds.push_back(length);
+
+  std::vector<EDS> chunks(bounds.size() - 1);
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::atomic<size_t> next_chunk(0);
+
+  auto worker = [&]()
+  {
+    size_t chunk;
+    while ((chunk = next_chunk++) < chunks.size())
+    {
+      try
+      {
+        MemoryStreambuf buffer(data + bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+        std::istream input(&buffer);
+        chunks[chunk].load_text(input);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+          error = std::current_exception();
+        next_chunk = chunks.size();
       }
-      current_pos = next_pos;
     }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::min<int>(threads, chunks.size()); ++i)
+    workers.emplace_back(worker);
+  for (auto & thread : workers)
+    thread.join();
+  munmap(mapping, length);
+
+  if (error)
+    std::rethrow_exception(error);
+
+  // chunks were parsed from position 1, append shifts them by the prefix sum of
+  // the reference lengths before them
+  size_t segments = size();
+  size_t arena_length = arena.length();
+  size_t variant_count = variants.size();
+  for (const auto & chunk : chunks)
+  {
+    segments += chunk.size();
+    arena_length += chunk.arena.length();
+    variant_count += chunk.variants.size();
+  }
+  positions.reserve(segments);
+  reference_offsets.reserve(segments);
+  reference_lengths.reserve(segments);
+  variant_begin.reserve(segments + 1);
+  arena.reserve(arena_length);
+  variants.reserve(variant_count);
+
+  for (auto & chunk : chunks)
+    append(std::move(chunk));
+  return true;
+}
+
+void EDS::append(EDS && other)
+{
+  if (other.source && source && other.source != source)
+    throw std::logic_error("Appended EDS refers to another reference sequence");
+  if (other.source)
+    source = other.source;
+  if (contig_name.empty())
+    contig_name = other.contig_name;
+
+  size_t shift = next_position() - 1;
+  size_t arena_shift = arena.length();
+  size_t variant_shift = variants.size();
+  for (size_t i = 0; i < other.size(); ++i)
+  {
+    positions.push_back(other.positions[i] + shift);
+    reference_offsets.push_back(other.reference_offsets[i] == span_offset ? span_offset
+                                                                          : other.reference_offsets[i] + arena_shift);
+    reference_lengths.push_back(other.reference_lengths[i]);
+    variant_begin.push_back(other.variant_begin[i + 1] + variant_shift);
   }
+  arena += other.arena;
+  for (auto variant : other.variants)
+    variants.push_back((variant & arena_variant) != 0 ? variant + arena_shift : variant);
+
+  other = EDS();
+}
+
+size_t EDS::size() const
+{
+  return positions.size();
 }
 
-const EDS::SegmentList & EDS::get_segments() const
+SegmentView EDS::segment(size_t idx) const
 {
-  return segments;
-}
\ No newline at end of file
+  return SegmentView(*this, idx);
+}
+
+EDS::const_iterator EDS::begin() const
+{
+  return const_iterator(*this, 0);
+}
+
+EDS::const_iterator EDS::end() const
+{
+  return const_iterator(*this, size());
+}
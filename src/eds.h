@@ -1,27 +1,55 @@
 #ifndef VCF2EDS_EDS_H
 #define VCF2EDS_EDS_H
 
+#include "allele.h"
+
+#include <htslib/thread_pool.h>
+
 #include <cstddef>
+#include <cstdint>
 #include <string>
-#include <unordered_set>
 #include <vector>
 #include <ostream>
 #include <memory>
 
+class ContigSequence;
+class EdsIndex;
+class EdsWriter;
+
 class Segment
 {
-  using VariantListType = std::unordered_set<std::string>;
 public:
+  using VariantListType = AlleleSet;
+
   Segment() = default;
   explicit Segment(size_t position);
   Segment(size_t position, std::string && reference);
 
+  /**
+   * Non-degenerate segment referring to length bases of source starting at position,
+   * the bases are read only when the segment is written. source must outlive the
+   * segment and any EDS it is added to.
+   */
+  Segment(size_t position, const ContigSequence & source, size_t length);
+
   void add_reference(const std::string & ref);
   void add_variant(const std::string & variant);
+  /**
+   * Adds the alternatives of a VCF record, short ones are interned.
+   */
   template<class InputIt>
-  void add_variants(InputIt first, InputIt last)
+  void intern_variants(InputIt first, InputIt last)
   {
-    variants.insert(first, last);
+    variants.intern(first, last);
+  }
+
+  /**
+   * Replaces the variants by a range of strings sorted and without duplicates.
+   */
+  template<class ForwardIt>
+  void assign_variants(ForwardIt first, ForwardIt last)
+  {
+    variants.assign_sorted(first, last);
   }
 
   size_t start_position() const;
@@ -29,33 +57,187 @@ public:
   size_t length() const;
   void merge(const Segment & segment);
 
+  const std::string & get_reference() const;
+  const VariantListType & get_variants() const;
+
   bool is_degenerate() const;
 
+  /**
+   * Source sequence of a reference span, nullptr when the reference is held by the
+   * segment itself.
+   */
+  const ContigSequence * get_source() const;
+
   friend std::ostream & operator << (std::ostream & os, const Segment & segment);
 private:
   size_t position = -1;
   std::string reference;
-  std::unordered_set<std::string> variants;
+  VariantListType variants;
+  const ContigSequence * source = nullptr;
+  size_t span_length = 0;
+};
+
+/**
+ * Non-owning reference to characters stored in an EDS or in the allele dictionary.
+ */
+struct StringRef
+{
+  const char * data;
+  size_t length;
+
+  std::string str() const;
+
+  friend std::ostream & operator << (std::ostream & os, const StringRef & string);
+};
+
+class EDS;
+
+/**
+ * Read-only view of one segment of an EDS, valid while the EDS is not modified.
+ */
+class SegmentView
+{
+public:
+  SegmentView(const EDS & eds, size_t idx);
+
+  size_t start_position() const;
+  size_t end_position() const;
+  size_t length() const;
+  bool is_degenerate() const;
+
+  /**
+   * Whether the reference is a span of the source sequence, such references are
+   * only available through write_reference.
+   */
+  bool is_span() const;
+  StringRef reference() const;
+  void write_reference(std::ostream & os) const;
+  void write_reference(EdsWriter & writer) const;
+
+  size_t variant_count() const;
+  StringRef variant(size_t variant_idx) const;
+
+  friend std::ostream & operator << (std::ostream & os, const SegmentView & segment);
+private:
+  const EDS & eds;
+  size_t idx;
 };
 
+/**
+ * Columnar EDS - segment start positions, one character arena holding the references
+ * of all segments and the variants that are not interned, and the ids of interned
+ * variants. References of non-degenerate segments built from a reference sequence
+ * stay spans of that sequence and are read from it only when the EDS is written.
+ */
 class EDS
 {
 public:
-  using SegmentList = std::vector<std::unique_ptr<Segment>>;
+  class const_iterator
+  {
+  public:
+    const_iterator(const EDS & eds, size_t idx);
+
+    SegmentView operator * () const;
+    const_iterator & operator ++ ();
+    bool operator != (const const_iterator & other) const;
+  private:
+    const EDS & eds;
+    size_t idx;
+  };
+
+  enum class Format
+  {
+    text,
+    binary
+  };
+
+  /**
+   * Parses an output format name - "text" or "binary".
+   */
+  static Format parse_format(const std::string & name);
 
   EDS() = default;
 
-  void save(std::ostream & os) const;
-  void load(std::istream & os);
+  /**
+   * With an index, checkpoints of the segments written are added to it as a new contig.
+   * With threads > 1, contiguous ranges of segments are formatted on threads threads
+   * and written in order, the output is the same as a serial save.
+   */
+  void save(std::ostream & os, Format format = Format::text, EdsIndex * index = nullptr, int threads = 1) const;
+
+  /**
+   * Appends the segments read from is, the format is detected from the content.
+   */
+  void load(std::istream & is);
+
+  /**
+   * Appends the segments of an EDS file. Uncompressed text is split into chunks before
+   * '{' and the chunks are parsed on threads threads, binary and compressed files are
+   * read serially. Returns false when the file cannot be opened.
+   */
+  bool load_file(const std::string & filename, int threads = 1, hts_tpool * pool = nullptr);
+
+  /**
+   * Name of the contig the EDS describes, stored in the binary format.
+   */
+  void set_contig(const std::string & name);
+  const std::string & contig() const;
 
   void add_segment(std::unique_ptr<Segment> && segment_ptr);
+  void add_segment(const Segment & segment);
 
-  const SegmentList & get_segments() const;
+  size_t size() const;
+  SegmentView segment(size_t idx) const;
+  const_iterator begin() const;
+  const_iterator end() const;
 
   friend std::ostream & operator << (std::ostream & os, const EDS & eds);
   friend std::istream & operator >> (std::istream & is, EDS & eds);
 private:
-  SegmentList segments;
+  friend class SegmentView;
+
+  static constexpr size_t span_offset = static_cast<size_t>(-1);
+  static constexpr uint64_t arena_variant = static_cast<uint64_t>(1) << 63;
+
+  void save_binary_header(std::ostream & os) const;
+
+  /**
+   * Writes the segments as text or as the payload of the binary format.
+   */
+  void save_segments(std::ostream & os, Format format, EdsIndex * index) const;
+  void save_segments(std::ostream & os, Format format, EdsIndex * index, int threads) const;
+  void load_text(std::istream & is);
+  void load_binary(std::istream & is);
+
+  /**
+   * Moves the segments of other, loaded from position 1, behind the segments of this.
+   */
+  void append(EDS && other);
+
+  /**
+   * Position following the last segment, where an appended segment starts.
+   */
+  size_t next_position() const;
+
+  void add_reference(const char * data, size_t length);
+  void add_span(size_t length);
+  void add_variant(const char * data, size_t length);
+  void add_variant(const AlleleEntry & variant);
+  StringRef variant_string(uint64_t variant) const;
+  void close_segment(size_t position);
+
+  std::vector<size_t> positions;
+  // reference of segment i occupies reference_lengths[i] bytes of the arena from
+  // reference_offsets[i], or of source from position - 1 when the offset is span_offset
+  std::vector<size_t> reference_offsets;
+  std::vector<size_t> reference_lengths;
+  std::string arena;
+  const ContigSequence * source = nullptr;
+  // segment i owns variants[variant_begin[i], variant_begin[i + 1]), a 32-bit interned id
+  // or, with arena_variant set, the arena offset of a 32-bit length followed by the bases
+  std::vector<size_t> variant_begin = {0};
+  std::vector<uint64_t> variants;
+  std::string contig_name;
 };
 
 #endif //VCF2EDS_EDS_H
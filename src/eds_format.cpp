@@ -0,0 +1,88 @@
+#include "eds_format.h"
+
+#include <stdexcept>
+
+namespace
+{
+  const char magic[4] = {'\x89', 'E', 'D', 'S'};
+
+  // magic, version, name length
+  constexpr size_t prefix_size = 12;
+  // reference length, segment count, total size, max alternatives, payload size
+  constexpr size_t fields_size = 5 * 8;
+
+  size_t padded(size_t length)
+  {
+    return (length + 7) & ~static_cast<size_t>(7);
+  }
+}
+
+constexpr uint32_t BinaryEdsHeader::version;
+
+bool BinaryEdsHeader::detect(std::istream & is)
+{
+  return is.peek() == static_cast<unsigned char>(magic[0]);
+}
+
+size_t BinaryEdsHeader::size() const
+{
+  return prefix_size + padded(contig.length()) + fields_size;
+}
+
+void BinaryEdsHeader::write(std::ostream & os) const
+{
+  std::string buffer(magic, sizeof(magic));
+  append_le32(buffer, version);
+  append_le32(buffer, static_cast<uint32_t>(contig.length()));
+  buffer += contig;
+  buffer.append(padded(contig.length()) - contig.length(), '\0');
+  append_le64(buffer, reference_length);
+  append_le64(buffer, segment_count);
+  append_le64(buffer, total_size);
+  append_le64(buffer, max_alternatives);
+  append_le64(buffer, payload_size);
+
+  os.write(buffer.data(), buffer.length());
+}
+
+bool BinaryEdsHeader::read(std::istream & is)
+{
+  char prefix[prefix_size];
+  is.read(prefix, prefix_size);
+  if (is.gcount() == 0)
+    return false;
+  if (static_cast<size_t>(is.gcount()) != prefix_size)
+    throw std::runtime_error("Truncated binary EDS header");
+
+  std::string data(prefix, prefix_size);
+  data.resize(prefix_size + padded(read_le32(prefix + 8)) + fields_size);
+  is.read(&data[prefix_size], data.length() - prefix_size);
+  if (static_cast<size_t>(is.gcount()) != data.length() - prefix_size)
+    throw std::runtime_error("Truncated binary EDS header");
+
+  parse(data.data(), data.length());
+  return true;
+}
+
+size_t BinaryEdsHeader::parse(const char * data, size_t length)
+{
+  if (length < prefix_size || std::memcmp(data, magic, sizeof(magic)) != 0)
+    throw std::runtime_error("Not a binary EDS");
+  if (read_le32(data + 4) != version)
+    throw std::runtime_error("Unsupported binary EDS version " + std::to_string(read_le32(data + 4)));
+
+  size_t name_length = read_le32(data + 8);
+  size_t header_size = prefix_size + padded(name_length) + fields_size;
+  if (length < header_size)
+    throw std::runtime_error("Truncated binary EDS header");
+
+  contig.assign(data + prefix_size, name_length);
+  const char * fields = data + prefix_size + padded(name_length);
+  reference_length = read_le64(fields);
+  segment_count = read_le64(fields + 8);
+  total_size = read_le64(fields + 16);
+  max_alternatives = read_le64(fields + 24);
+  payload_size = read_le64(fields + 32);
+
+  return header_size;
+}
@@ -0,0 +1,86 @@
+#ifndef VCF2EDS_EDS_FORMAT_H
+#define VCF2EDS_EDS_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <endian.h>
+
+/**
+ * Header of a binary EDS container. Integers are little-endian:
+ *
+ *   magic "\x89EDS", u32 version, u32 length of the contig name,
+ *   contig name padded with zeros to a multiple of 8 bytes,
+ *   u64 reference length, u64 segment count, u64 total size N (all strings),
+ *   u64 largest number of alternatives, u64 payload size,
+ *   u64 offsets[segment count + 1] of the segments in the payload, payload.
+ *
+ * A segment in the payload is u64 start position, u32 number of alternatives,
+ * then the reference and the alternatives, each as u32 length and bytes.
+ * A file may hold several containers one after another, e.g. one per contig.
+ */
+struct BinaryEdsHeader
+{
+  static constexpr uint32_t version = 1;
+
+  std::string contig;
+  uint64_t reference_length = 0;
+  uint64_t segment_count = 0;
+  uint64_t total_size = 0;
+  uint64_t max_alternatives = 0;
+  uint64_t payload_size = 0;
+
+  /**
+   * Whether the stream continues with a binary container, nothing is consumed.
+   */
+  static bool detect(std::istream & is);
+
+  /**
+   * Bytes taken by the header, the offset table follows right after it.
+   */
+  size_t size() const;
+
+  void write(std::ostream & os) const;
+
+  /**
+   * Returns false at the end of the stream, throws on anything but a valid header.
+   */
+  bool read(std::istream & is);
+
+  /**
+   * Parses a header from memory, returns its size. Throws when it is not valid.
+   */
+  size_t parse(const char * data, size_t length);
+};
+
+inline void append_le32(std::string & buffer, uint32_t value)
+{
+  value = htole32(value);
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+inline void append_le64(std::string & buffer, uint64_t value)
+{
+  value = htole64(value);
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+inline uint32_t read_le32(const char * data)
+{
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return le32toh(value);
+}
+
+inline uint64_t read_le64(const char * data)
+{
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return le64toh(value);
+}
+
+#endif //VCF2EDS_EDS_FORMAT_H
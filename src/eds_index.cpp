@@ -0,0 +1,382 @@
+#include "eds_index.h"
+#include "bgzf_stream.h"
+#include "eds_format.h"
+#include "eds_writer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+  const char magic[4] = {'\x89', 'E', 'D', 'I'};
+  // version 1 held BGZF virtual offsets for compressed files
+  constexpr uint32_t version = 2;
+  constexpr uint32_t binary_flag = 1;
+
+  constexpr size_t read_chunk = 16 * 1024;
+
+  /**
+   * Bounds checked reading of the index file.
+   */
+  class IndexCursor
+  {
+  public:
+    IndexCursor(const std::string & data, size_t offset)
+      : data(data), offset(offset)
+    { }
+
+    const char * take(size_t length)
+    {
+      if (data.length() - offset < length)
+        throw std::runtime_error("Truncated EDS index");
+      offset += length;
+      return data.data() + offset - length;
+    }
+
+    uint32_t u32()
+    {
+      return read_le32(take(4));
+    }
+
+    uint64_t u64()
+    {
+      return read_le64(take(8));
+    }
+  private:
+    const std::string & data;
+    size_t offset;
+  };
+
+  void truncated()
+  {
+    throw std::runtime_error("Truncated EDS");
+  }
+}
+
+constexpr size_t EdsIndex::default_stride;
+
+EdsIndex::EdsIndex(size_t stride, bool binary)
+  : stride(std::max<size_t>(stride, 1)), binary(binary)
+{ }
+
+uint64_t EdsIndex::tell(std::ostream & os)
+{
+  auto offset = os.tellp();
+  if (offset == std::ostream::pos_type(-1))
+    throw std::runtime_error("EDS output does not report offsets for the index");
+
+  return static_cast<uint64_t>(static_cast<std::streamoff>(offset));
+}
+
+uint64_t EdsIndex::tell(EdsWriter & writer)
+{
+  return writer.tell();
+}
+
+void EdsIndex::begin_contig(const std::string & name)
+{
+  contig_list.emplace_back();
+  contig_list.back().name = name;
+}
+
+bool EdsIndex::checkpoint_due(size_t position) const
+{
+  if (contig_list.empty() || contig_list.back().checkpoints.empty())
+    return true;
+
+  return position / stride > contig_list.back().checkpoints.back().position / stride;
+}
+
+void EdsIndex::add_checkpoint(size_t position, uint64_t offset)
+{
+  if (contig_list.empty())
+    begin_contig("");
+
+  auto & contig = contig_list.back();
+  contig.checkpoints.push_back(Checkpoint{position, contig.segment_count, offset});
+}
+
+void EdsIndex::add_segment(size_t position, size_t length)
+{
+  if (contig_list.empty())
+    begin_contig("");
+
+  auto & contig = contig_list.back();
+  contig.segment_count += 1;
+  contig.end_position = position + length;
+}
+
+bool EdsIndex::save(const std::string & filename) const
+{
+  std::string buffer(magic, sizeof(magic));
+  append_le32(buffer, version);
+  append_le32(buffer, binary ? binary_flag : 0);
+  append_le64(buffer, stride);
+  append_le32(buffer, static_cast<uint32_t>(contig_list.size()));
+  for (const auto & contig : contig_list)
+  {
+    append_le32(buffer, static_cast<uint32_t>(contig.name.length()));
+    buffer += contig.name;
+    append_le64(buffer, contig.segment_count);
+    append_le64(buffer, contig.end_position);
+    append_le64(buffer, contig.checkpoints.size());
+    for (const auto & checkpoint : contig.checkpoints)
+    {
+      append_le64(buffer, checkpoint.position);
+      append_le64(buffer, checkpoint.segment);
+      append_le64(buffer, checkpoint.offset);
+    }
+  }
+
+  std::ofstream output(filename, std::ios::binary);
+  output.write(buffer.data(), buffer.length());
+  return static_cast<bool>(output);
+}
+
+bool EdsIndex::load(const std::string & filename)
+{
+  std::ifstream input(filename, std::ios::binary);
+  if (!input.is_open())
+    return false;
+
+  std::string data((std::istreambuf_iterator<char>(input)),
+                   std::istreambuf_iterator<char>());
+  IndexCursor cursor(data, 0);
+  if (std::string(cursor.take(sizeof(magic)), sizeof(magic)) != std::string(magic, sizeof(magic)))
+    throw std::runtime_error("Not an EDS index: " + filename);
+  if (cursor.u32() != version)
+    throw std::runtime_error("Unsupported EDS index version: " + filename);
+
+  binary = cursor.u32() & binary_flag;
+  stride = cursor.u64();
+  contig_list.clear();
+  contig_list.resize(cursor.u32());
+  for (auto & contig : contig_list)
+  {
+    size_t name_length = cursor.u32();
+    contig.name.assign(cursor.take(name_length), name_length);
+    contig.segment_count = cursor.u64();
+    contig.end_position = cursor.u64();
+
+    uint64_t count = cursor.u64();
+    if (count > data.length() / 24)
+      throw std::runtime_error("Truncated EDS index");
+    contig.checkpoints.resize(count);
+    for (auto & checkpoint : contig.checkpoints)
+    {
+      checkpoint.position = cursor.u64();
+      checkpoint.segment = cursor.u64();
+      checkpoint.offset = cursor.u64();
+    }
+  }
+
+  return true;
+}
+
+bool EdsIndex::is_binary() const
+{
+  return binary;
+}
+
+size_t EdsIndex::get_stride() const
+{
+  return stride;
+}
+
+const std::vector<EdsIndex::Contig> & EdsIndex::contigs() const
+{
+  return contig_list;
+}
+
+const EdsIndex::Contig * EdsIndex::find(const std::string & contig) const
+{
+  for (const auto & candidate : contig_list)
+  {
+    if (candidate.name == contig)
+      return &candidate;
+  }
+
+  return nullptr;
+}
+
+const EdsIndex::Checkpoint * EdsIndex::checkpoint(const Contig & contig, size_t position) const
+{
+  auto after = std::upper_bound(contig.checkpoints.begin(), contig.checkpoints.end(), position,
+                                [](size_t p, const Checkpoint & c) { return p < c.position; });
+  if (after == contig.checkpoints.begin())
+    return nullptr;
+
+  return &*(after - 1);
+}
+
+std::unique_ptr<IndexedEdsReader> IndexedEdsReader::open(const std::string & filename, hts_tpool * pool)
+{
+  std::unique_ptr<IndexedEdsReader> reader(new IndexedEdsReader());
+  if (!reader->index.load(filename + ".edsi"))
+    return nullptr;
+
+  // gzip magic - offsets are mapped to blocks through the .gzi index
+  char bytes[2] = {0, 0};
+  std::ifstream plain(filename, std::ios::binary);
+  if (!plain.read(bytes, 2))
+    return nullptr;
+
+  if (bytes[0] == '\x1f' && bytes[1] == '\x8b')
+  {
+    if (!std::ifstream(filename + ".gzi"))
+      return nullptr;
+
+    auto compressed = std::make_unique<BgzfInputStream>(filename, pool);
+    if (!compressed->is_open())
+      return nullptr;
+    reader->input = std::move(compressed);
+  }
+  else
+  {
+    plain.seekg(0);
+    reader->input = std::make_unique<std::ifstream>(std::move(plain));
+  }
+
+  return reader;
+}
+
+const EdsIndex & IndexedEdsReader::get_index() const
+{
+  return index;
+}
+
+bool IndexedEdsReader::seek(const std::string & contig_name, size_t target)
+{
+  contig = index.find(contig_name);
+  pending.reset();
+  if (!contig || target >= contig->end_position)
+    return false;
+
+  const auto * checkpoint = index.checkpoint(*contig, target);
+  if (!checkpoint)
+    return false;
+
+  input->clear();
+  if (!input->seekg(checkpoint->offset))
+    throw std::runtime_error("Could not seek in the EDS file");
+  position = checkpoint->position;
+  segment_idx = checkpoint->segment;
+
+  auto segment = std::make_unique<Segment>();
+  while (next(*segment))
+  {
+    // segments with an empty reference (insertions) sit right before their position
+    if (segment->start_position() + std::max<size_t>(segment->length(), 1) > target)
+    {
+      pending = std::move(segment);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool IndexedEdsReader::next(Segment & segment)
+{
+  if (pending)
+  {
+    segment = std::move(*pending);
+    pending.reset();
+    return true;
+  }
+  if (!contig)
+    return false;
+
+  bool read = index.is_binary() ? read_binary(segment) : read_text(segment);
+  if (read)
+  {
+    position = segment.start_position() + segment.length();
+    segment_idx += 1;
+  }
+  return read;
+}
+
+bool IndexedEdsReader::read_text(Segment & segment)
+{
+  if (position >= contig->end_position)
+    return false;
+
+  int c = input->peek();
+  if (c == std::char_traits<char>::eof())
+    truncated();
+
+  if (c == '{')
+  {
+    input->get();
+
+    std::string body;
+    if (!std::getline(*input, body, '}'))
+      truncated();
+    size_t comma = body.find(',');
+    if (comma == std::string::npos)
+      throw std::runtime_error("Malformed EDS segment at " + std::to_string(position));
+
+    segment = Segment(position, body.substr(0, comma));
+    while (comma != std::string::npos)
+    {
+      size_t next_comma = body.find(',', comma + 1);
+      segment.add_variant(body.substr(comma + 1, next_comma == std::string::npos ? std::string::npos
+                                                                                 : next_comma - comma - 1));
+      comma = next_comma;
+    }
+    return true;
+  }
+
+  // a reference run ends before the next '{', or where the contig ends when the
+  // next contig follows in the same file
+  std::string reference;
+  char buffer[read_chunk];
+  size_t remaining = contig->end_position - position;
+  while (remaining > 0)
+  {
+    size_t count = std::min(remaining, read_chunk - 1);
+    input->get(buffer, count + 1, '{');
+    size_t extracted = input->gcount();
+    reference.append(buffer, extracted);
+    remaining -= extracted;
+    if (extracted < count)
+      break;
+  }
+  if (reference.empty())
+    truncated();
+  input->clear(input->rdstate() & ~std::ios::failbit);
+
+  segment = Segment(position, std::move(reference));
+  return true;
+}
+
+bool IndexedEdsReader::read_binary(Segment & segment)
+{
+  if (segment_idx >= contig->segment_count)
+    return false;
+
+  char header[16];
+  if (!input->read(header, sizeof(header)))
+    truncated();
+  uint32_t alternatives = read_le32(header + 8);
+
+  std::string string(read_le32(header + 12), '\0');
+  if (!input->read(&string[0], string.length()))
+    truncated();
+  segment = Segment(read_le64(header), std::move(string));
+
+  for (uint32_t i = 0; i < alternatives; ++i)
+  {
+    char length[4];
+    if (!input->read(length, sizeof(length)))
+      truncated();
+    string.assign(read_le32(length), '\0');
+    if (!input->read(&string[0], string.length()))
+      truncated();
+    segment.add_variant(string);
+  }
+
+  return true;
+}
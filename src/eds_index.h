@@ -0,0 +1,141 @@
+#ifndef VCF2EDS_EDS_INDEX_H
+#define VCF2EDS_EDS_INDEX_H
+
+#include "eds.h"
+
+#include <htslib/thread_pool.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class EdsWriter;
+
+/**
+ * Coordinate index of an EDS file, saved next to it as .edsi. Per contig it samples
+ * checkpoints (reference position -> segment number, offset of the segment in the
+ * file): the first segment starting in every stride bases of the reference. Offsets
+ * are byte offsets in the uncompressed EDS, a compressed EDS is read through the .gzi
+ * index written next to it.
+ */
+class EdsIndex
+{
+public:
+  static constexpr size_t default_stride = 64 * 1024;
+
+  struct Checkpoint
+  {
+    uint64_t position;
+    uint64_t segment;
+    uint64_t offset;
+  };
+
+  struct Contig
+  {
+    std::string name;
+    uint64_t segment_count = 0;
+    // position following the last segment
+    uint64_t end_position = 1;
+    std::vector<Checkpoint> checkpoints;
+  };
+
+  explicit EdsIndex(size_t stride = default_stride, bool binary = false);
+
+  /**
+   * Offset of the next byte written to os or through writer, as recorded in checkpoints.
+   */
+  static uint64_t tell(std::ostream & os);
+  static uint64_t tell(EdsWriter & writer);
+
+  /**
+   * Segments added from now on belong to contig name.
+   */
+  void begin_contig(const std::string & name);
+
+  /**
+   * Whether the segment starting at position gets a checkpoint, which is then added
+   * by add_checkpoint before the segment itself is added.
+   */
+  bool checkpoint_due(size_t position) const;
+  void add_checkpoint(size_t position, uint64_t offset);
+  void add_segment(size_t position, size_t length);
+
+  /**
+   * Adds a segment about to be written to output - a stream or an EdsWriter - with its
+   * checkpoint when one is due.
+   */
+  template<class Output, class SegmentType>
+  void add(Output & output, const SegmentType & segment)
+  {
+    if (checkpoint_due(segment.start_position()))
+      add_checkpoint(segment.start_position(), tell(output));
+    add_segment(segment.start_position(), segment.length());
+  }
+
+  bool save(const std::string & filename) const;
+
+  /**
+   * Throws std::runtime_error when the file exists but is not a valid index.
+   */
+  bool load(const std::string & filename);
+
+  bool is_binary() const;
+  size_t get_stride() const;
+  const std::vector<Contig> & contigs() const;
+  const Contig * find(const std::string & contig) const;
+
+  /**
+   * Last checkpoint at or before position, the segment covering position is found by
+   * reading forward from it. nullptr when the contig does not start before position.
+   */
+  const Checkpoint * checkpoint(const Contig & contig, size_t position) const;
+private:
+  size_t stride;
+  bool binary;
+  std::vector<Contig> contig_list;
+};
+
+/**
+ * Reads segments of an indexed EDS file, text or binary, plain or BGZF compressed,
+ * starting at any reference coordinate.
+ */
+class IndexedEdsReader
+{
+public:
+  /**
+   * Opens filename and filename.edsi, plus filename.gzi when the EDS is compressed.
+   * Returns nullptr when any of them is missing.
+   */
+  static std::unique_ptr<IndexedEdsReader> open(const std::string & filename, hts_tpool * pool = nullptr);
+
+  const EdsIndex & get_index() const;
+
+  /**
+   * Positions the reader at the segment of contig covering position, so that next
+   * returns it first. Returns false when no segment of the contig covers position.
+   */
+  bool seek(const std::string & contig, size_t position);
+
+  /**
+   * Reads the next segment of the contig, returns false past its end.
+   */
+  bool next(Segment & segment);
+private:
+  IndexedEdsReader() = default;
+
+  bool read_text(Segment & segment);
+  bool read_binary(Segment & segment);
+
+  EdsIndex index;
+  std::unique_ptr<std::istream> input;
+  const EdsIndex::Contig * contig = nullptr;
+  size_t position = 0;
+  size_t segment_idx = 0;
+  std::unique_ptr<Segment> pending;
+};
+
+#endif //VCF2EDS_EDS_INDEX_H
@@ -0,0 +1,255 @@
+#include "eds_parser.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VCF2EDS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  /**
+   * First occurrence of a or b in [begin, end), end when there is none.
+   */
+  using FindKernel = const char * (*)(const char * begin, const char * end, char a, char b);
+
+  const char * find_scalar(const char * begin, const char * end, char a, char b)
+  {
+    for (; begin != end; ++begin)
+    {
+      if (*begin == a || *begin == b)
+        break;
+    }
+    return begin;
+  }
+
+#ifdef VCF2EDS_X86_KERNELS
+  __attribute__((target("sse2")))
+  const char * find_sse2(const char * begin, const char * end, char a, char b)
+  {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - begin >= 16; begin += 16)
+    {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+      int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)));
+      if (mask)
+        return begin + __builtin_ctz(mask);
+    }
+    return find_scalar(begin, end, a, b);
+  }
+
+  __attribute__((target("avx2")))
+  const char * find_avx2(const char * begin, const char * end, char a, char b)
+  {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    for (; end - begin >= 32; begin += 32)
+    {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+      uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, va),
+                                                            _mm256_cmpeq_epi8(block, vb)));
+      if (mask)
+        return begin + __builtin_ctz(mask);
+    }
+    return find_sse2(begin, end, a, b);
+  }
+#endif
+
+  struct Kernel
+  {
+    const char * name;
+    FindKernel find;
+  };
+
+  Kernel select_kernel()
+  {
+    // VCF2EDS_KERNEL names the only kernel allowed, so tests can run each of them
+    const char * forced = std::getenv("VCF2EDS_KERNEL");
+    auto allowed = [forced](const char * name) { return !forced || std::strcmp(forced, name) == 0; };
+#ifdef VCF2EDS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && allowed("avx2"))
+      return Kernel{"avx2", find_avx2};
+    if (__builtin_cpu_supports("sse2") && allowed("sse2"))
+      return Kernel{"sse2", find_sse2};
+#endif
+    (void) allowed;
+    return Kernel{"scalar", find_scalar};
+  }
+
+  const Kernel & active_kernel()
+  {
+    static const Kernel selected = select_kernel();
+    return selected;
+  }
+}
+
+size_t ParsedSegment::length() const
+{
+  return reference.length;
+}
+
+bool ParsedSegment::is_degenerate() const
+{
+  return !variants.empty();
+}
+
+constexpr size_t EdsTextParser::default_buffer_size;
+
+EdsTextParser::const_iterator::const_iterator(EdsTextParser * parser)
+  : parser(parser)
+{ }
+
+const ParsedSegment & EdsTextParser::const_iterator::operator * () const
+{
+  return parser->current;
+}
+
+const ParsedSegment * EdsTextParser::const_iterator::operator -> () const
+{
+  return &parser->current;
+}
+
+EdsTextParser::const_iterator & EdsTextParser::const_iterator::operator ++ ()
+{
+  if (!parser->next(parser->current))
+    parser = nullptr;
+  return *this;
+}
+
+bool EdsTextParser::const_iterator::operator != (const const_iterator & other) const
+{
+  return parser != other.parser;
+}
+
+EdsTextParser::EdsTextParser(std::istream & is, size_t first_position, size_t buffer_size)
+  : is(is), next_position(first_position), buffer(std::max<size_t>(buffer_size, 64))
+{ }
+
+EdsTextParser::const_iterator EdsTextParser::begin()
+{
+  return const_iterator(next(current) ? this : nullptr);
+}
+
+EdsTextParser::const_iterator EdsTextParser::end()
+{
+  return const_iterator(nullptr);
+}
+
+const char * EdsTextParser::kernel()
+{
+  return active_kernel().name;
+}
+
+bool EdsTextParser::refill()
+{
+  if (eof)
+    return false;
+
+  if (begin_offset > 0)
+  {
+    std::copy(buffer.begin() + begin_offset, buffer.begin() + end_offset, buffer.begin());
+    end_offset -= begin_offset;
+    begin_offset = 0;
+  }
+  if (end_offset == buffer.size())
+    buffer.resize(2 * buffer.size());
+
+  is.read(buffer.data() + end_offset, buffer.size() - end_offset);
+  size_t count = is.gcount();
+  end_offset += count;
+  if (count == 0 || !is)
+    eof = true;
+
+  return count > 0;
+}
+
+bool EdsTextParser::next(ParsedSegment & segment)
+{
+  const FindKernel find = active_kernel().find;
+
+  if (begin_offset == end_offset && !refill())
+    return false;
+
+  segment.position = next_position;
+  segment.variants.clear();
+
+  if (buffer[begin_offset] != '{')
+  {
+    // reference run up to the next '{' - read more while the run is short, yield
+    // the buffer as a piece of the run once it holds at least half a buffer
+    size_t scanned = begin_offset;
+    while (true)
+    {
+      const char * data = buffer.data();
+      const char * brace = find(data + scanned, data + end_offset, '{', '}');
+      if (brace != data + end_offset)
+      {
+        if (*brace == '}')
+          throw std::runtime_error("Unmatched '}' at " + std::to_string(next_position + (brace - data) - begin_offset));
+        segment.reference = StringRef{data + begin_offset, static_cast<size_t>(brace - data) - begin_offset};
+        break;
+      }
+
+      scanned = end_offset - begin_offset;
+      if (eof || 2 * (end_offset - begin_offset) >= buffer.size() || !refill())
+      {
+        segment.reference = StringRef{buffer.data() + begin_offset, end_offset - begin_offset};
+        break;
+      }
+      scanned += begin_offset;
+    }
+
+    begin_offset += segment.reference.length;
+    next_position += segment.reference.length;
+    return true;
+  }
+
+  // {reference,variant,...} - the whole group has to be in the buffer, its commas are
+  // found in the same scan as the closing brace; offsets count from the '{' as a
+  // refill moves the group to the front of the buffer
+  commas.clear();
+  size_t scanned = 1;
+  size_t closing;
+  while (true)
+  {
+    const char * group = buffer.data() + begin_offset;
+    const char * last = buffer.data() + end_offset;
+    const char * delimiter = find(group + scanned, last, ',', '}');
+    if (delimiter == last)
+    {
+      scanned = end_offset - begin_offset;
+      if (!refill())
+        throw std::runtime_error("Unterminated degenerate segment at " + std::to_string(next_position));
+      continue;
+    }
+
+    scanned = delimiter - group + 1;
+    if (*delimiter == '}')
+    {
+      closing = delimiter - group;
+      break;
+    }
+    commas.push_back(delimiter - group);
+  }
+
+  if (commas.empty())
+    throw std::runtime_error("Degenerate segment without variants at " + std::to_string(next_position));
+
+  const char * group = buffer.data() + begin_offset;
+  segment.reference = StringRef{group + 1, commas.front() - 1};
+  for (size_t i = 0; i < commas.size(); ++i)
+  {
+    size_t string_end = i + 1 < commas.size() ? commas[i + 1] : closing;
+    segment.variants.push_back(StringRef{group + commas[i] + 1, string_end - commas[i] - 1});
+  }
+
+  begin_offset += closing + 1;
+  next_position += segment.reference.length;
+  return true;
+}
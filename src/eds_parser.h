@@ -0,0 +1,87 @@
+#ifndef VCF2EDS_EDS_PARSER_H
+#define VCF2EDS_EDS_PARSER_H
+
+#include "eds.h"
+
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+/**
+ * Segment yielded by EdsTextParser, its strings point into the parser buffer and
+ * stay valid until the parser reads the next segment.
+ */
+struct ParsedSegment
+{
+  size_t position = 1;
+  StringRef reference{nullptr, 0};
+  std::vector<StringRef> variants;
+
+  size_t length() const;
+  bool is_degenerate() const;
+};
+
+/**
+ * Pull parser of text EDS reading the stream in chunks. Delimiters are found with
+ * SSE2/AVX2 where available, positions are reference coordinates counted from
+ * first_position. Memory stays within the buffer size: reference runs longer than
+ * the buffer are yielded in consecutive pieces, only a degenerate segment that does
+ * not fit makes the buffer grow. Throws std::runtime_error on malformed input.
+ */
+class EdsTextParser
+{
+public:
+  static constexpr size_t default_buffer_size = 1 << 20;
+
+  class const_iterator
+  {
+  public:
+    const_iterator(EdsTextParser * parser);
+
+    const ParsedSegment & operator * () const;
+    const ParsedSegment * operator -> () const;
+    const_iterator & operator ++ ();
+    bool operator != (const const_iterator & other) const;
+  private:
+    EdsTextParser * parser;
+  };
+
+  explicit EdsTextParser(std::istream & is, size_t first_position = 1, size_t buffer_size = default_buffer_size);
+
+  /**
+   * Parses the next segment into segment, returns false at the end of the stream.
+   */
+  bool next(ParsedSegment & segment);
+
+  /**
+   * Single pass iteration - begin reads the first segment.
+   */
+  const_iterator begin();
+  const_iterator end();
+
+  /**
+   * Name of the delimiter scanning kernel picked for this CPU - "avx2", "sse2" or "scalar".
+   * Setting VCF2EDS_KERNEL to a name restricts the choice to that kernel, any other
+   * value to the scalar one.
+   */
+  static const char * kernel();
+private:
+  /**
+   * Moves the unread bytes to the front and reads more, growing the buffer when it is
+   * full. Returns false when nothing more could be read.
+   */
+  bool refill();
+
+  std::istream & is;
+  size_t next_position;
+  std::vector<char> buffer;
+  size_t begin_offset = 0;
+  size_t end_offset = 0;
+  bool eof = false;
+  ParsedSegment current;
+  bool current_valid = false;
+  // offsets of the commas of the group being parsed from its '{'
+  std::vector<size_t> commas;
+};
+
+#endif //VCF2EDS_EDS_PARSER_H
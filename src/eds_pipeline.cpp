@@ -0,0 +1,185 @@
+#include "eds_pipeline.h"
+#include "eds_writer.h"
+
+#include <streambuf>
+
+namespace
+{
+  constexpr size_t serializer_buffer = 64 * 1024;
+
+  /**
+   * Write-only stream buffer appending to a string.
+   */
+  class StringStreambuf : public std::streambuf
+  {
+  public:
+    explicit StringStreambuf(std::string & target)
+      : target(target)
+    { }
+  protected:
+    std::streamsize xsputn(const char * data, std::streamsize count) override
+    {
+      target.append(data, count);
+      return count;
+    }
+
+    int_type overflow(int_type c) override
+    {
+      if (!traits_type::eq_int_type(c, traits_type::eof()))
+        target.push_back(traits_type::to_char_type(c));
+      return traits_type::not_eof(c);
+    }
+  private:
+    std::string & target;
+  };
+}
+
+constexpr size_t PipelinedEdsWriter::batch_size;
+constexpr size_t PipelinedEdsWriter::buffer_size;
+constexpr size_t PipelinedEdsWriter::queue_depth;
+
+PipelinedEdsWriter::PipelinedEdsWriter(std::ostream & os, EdsIndex * index)
+  : os(os), index(index), batches(queue_depth), buffers(queue_depth)
+{
+  batch.reserve(batch_size);
+  serializer = std::thread(&PipelinedEdsWriter::serialize, this);
+  writer = std::thread(&PipelinedEdsWriter::output, this);
+}
+
+PipelinedEdsWriter::~PipelinedEdsWriter()
+{
+  abort();
+}
+
+void PipelinedEdsWriter::add(std::unique_ptr<Segment> && segment)
+{
+  batch.push_back(std::move(segment));
+  if (batch.size() >= batch_size)
+    push_batch();
+}
+
+void PipelinedEdsWriter::finish()
+{
+  if (finished)
+    return;
+
+  finished = true;
+  if (!batch.empty())
+    batches.push(std::move(batch));
+  batches.close();
+  serializer.join();
+  writer.join();
+  rethrow();
+}
+
+void PipelinedEdsWriter::abort()
+{
+  if (finished)
+    return;
+
+  finished = true;
+  aborted = true;
+  batches.close();
+  buffers.close();
+  serializer.join();
+  writer.join();
+}
+
+void PipelinedEdsWriter::push_batch()
+{
+  if (!batches.push(std::move(batch)))
+    rethrow();
+  batch = Batch();
+  batch.reserve(batch_size);
+}
+
+void PipelinedEdsWriter::serialize()
+{
+  try
+  {
+    Buffer buffer;
+    StringStreambuf target(buffer.data);
+    std::ostream stream(&target);
+    EdsWriter formatter(stream, serializer_buffer);
+    uint64_t buffer_start = 0;
+
+    Batch input;
+    while (!aborted && batches.pop(input))
+    {
+      for (const auto & segment : input)
+      {
+        if (index)
+          buffer.marks.push_back(Mark{segment->start_position(), segment->length(),
+                                      static_cast<size_t>(formatter.size() - buffer_start)});
+        formatter.write_text(*segment);
+
+        if (formatter.size() - buffer_start >= buffer_size)
+        {
+          formatter.flush();
+          buffer_start = formatter.size();
+          if (!buffers.push(std::move(buffer)))
+            return;
+          buffer = Buffer();
+        }
+      }
+    }
+
+    formatter.flush();
+    if (!buffer.data.empty() || !buffer.marks.empty())
+      buffers.push(std::move(buffer));
+  }
+  catch (...)
+  {
+    fail();
+    return;
+  }
+
+  buffers.close();
+}
+
+void PipelinedEdsWriter::output()
+{
+  try
+  {
+    Buffer buffer;
+    // the queues are drained on close, an abort stops at the next buffer
+    while (!aborted && buffers.pop(buffer))
+    {
+      // the buffer is split at checkpoints, so that the index sees the stream offset
+      size_t written = 0;
+      for (const auto & mark : buffer.marks)
+      {
+        if (index->checkpoint_due(mark.position))
+        {
+          os.write(buffer.data.data() + written, mark.offset - written);
+          written = mark.offset;
+          index->add_checkpoint(mark.position, EdsIndex::tell(os));
+        }
+        index->add_segment(mark.position, mark.length);
+      }
+      os.write(buffer.data.data() + written, buffer.data.length() - written);
+    }
+  }
+  catch (...)
+  {
+    fail();
+  }
+}
+
+void PipelinedEdsWriter::fail()
+{
+  {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!error)
+      error = std::current_exception();
+  }
+  batches.close();
+  buffers.close();
+}
+
+void PipelinedEdsWriter::rethrow()
+{
+  std::lock_guard<std::mutex> lock(error_mutex);
+  if (error)
+    std::rethrow_exception(error);
+}
@@ -0,0 +1,106 @@
+#ifndef VCF2EDS_EDS_PIPELINE_H
+#define VCF2EDS_EDS_PIPELINE_H
+
+#include "eds.h"
+#include "eds_index.h"
+#include "utils/spsc_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Serialization and output stages of a conversion. Segments added are formatted as
+ * text on a serializer thread and the formatted buffers are written to the stream by
+ * an output thread, while the caller goes on building segments. The stages are
+ * connected by bounded SPSC queues, so a slow output holds the producer back instead
+ * of the whole EDS piling up in memory.
+ */
+class PipelinedEdsWriter
+{
+public:
+  static constexpr size_t batch_size = 1024;
+  static constexpr size_t buffer_size = 1 << 20;
+  static constexpr size_t queue_depth = 8;
+
+  /**
+   * With an index, the segments are added to it as they are written, after the
+   * begin_contig of the caller. os and index belong to the output thread until finish.
+   */
+  explicit PipelinedEdsWriter(std::ostream & os, EdsIndex * index = nullptr);
+
+  /**
+   * Aborts the stages when finish was not called.
+   */
+  ~PipelinedEdsWriter();
+
+  PipelinedEdsWriter(const PipelinedEdsWriter &) = delete;
+  PipelinedEdsWriter & operator = (const PipelinedEdsWriter &) = delete;
+
+  /**
+   * Hands the segment to the serializer, waits while the queues are full. Rethrows
+   * the error of a failed stage.
+   */
+  void add(std::unique_ptr<Segment> && segment);
+
+  /**
+   * Writes everything added, stops the stage threads and rethrows the error of a
+   * failed stage.
+   */
+  void finish();
+
+  /**
+   * Stops the stage threads, segments not written yet are dropped. For output that
+   * is going to be discarded.
+   */
+  void abort();
+private:
+  using Batch = std::vector<std::unique_ptr<Segment>>;
+
+  struct Mark
+  {
+    size_t position;
+    size_t length;
+    size_t offset;
+  };
+
+  /**
+   * Text of consecutive segments. With an index, marks hold the position, length and
+   * offset in data of each segment.
+   */
+  struct Buffer
+  {
+    std::string data;
+    std::vector<Mark> marks;
+  };
+
+  void push_batch();
+  void serialize();
+  void output();
+
+  /**
+   * Keeps the current exception and closes the queues, so the other stages stop.
+   */
+  void fail();
+  void rethrow();
+
+  std::ostream & os;
+  EdsIndex * index;
+  Batch batch;
+  SpscQueue<Batch> batches;
+  SpscQueue<Buffer> buffers;
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::thread serializer;
+  std::thread writer;
+  std::atomic<bool> aborted{false};
+  bool finished = false;
+};
+
+#endif //VCF2EDS_EDS_PIPELINE_H
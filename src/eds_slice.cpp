@@ -0,0 +1,62 @@
+#include "eds_slice.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+EDS slice_eds(IndexedEdsReader & reader, const Region & region)
+{
+  EDS eds;
+  eds.set_contig(region.contig);
+  if (!reader.seek(region.contig, region.begin))
+    return eds;
+
+  Segment segment;
+  while (reader.next(segment) && segment.start_position() <= region.end)
+  {
+    if (segment.is_degenerate())
+    {
+      eds.add_segment(segment);
+      continue;
+    }
+
+    size_t begin = std::max(segment.start_position(), region.begin);
+    size_t end = std::min(segment.end_position(), region.end);
+    if (begin == segment.start_position() && end == segment.end_position())
+    {
+      eds.add_segment(segment);
+      continue;
+    }
+
+    eds.add_segment(Segment(begin, segment.get_reference().substr(begin - segment.start_position(), end - begin + 1)));
+  }
+
+  return eds;
+}
+
+std::vector<Region> read_bed(const std::string & filename)
+{
+  std::ifstream input(filename);
+  if (!input.is_open())
+    throw std::runtime_error("Could not open BED file " + filename);
+
+  std::vector<Region> regions;
+  std::string line;
+  while (std::getline(input, line))
+  {
+    if (line.empty() || line[0] == '#' || line.compare(0, 5, "track") == 0 || line.compare(0, 7, "browser") == 0)
+      continue;
+
+    // 0-based start, exclusive end
+    std::istringstream columns(line);
+    Region region;
+    size_t start;
+    if (!(columns >> region.contig >> start >> region.end) || region.end <= start)
+      throw std::runtime_error("Invalid BED line: " + line);
+    region.begin = start + 1;
+    regions.push_back(std::move(region));
+  }
+
+  return regions;
+}
@@ -0,0 +1,25 @@
+#ifndef VCF2EDS_EDS_SLICE_H
+#define VCF2EDS_EDS_SLICE_H
+
+#include "converter.h"
+#include "eds.h"
+#include "eds_index.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Extracts a region of an indexed EDS, segments keep their reference coordinates.
+ * Reference segments are cut at the region edges. Degenerate segments overlapping the
+ * region are kept whole, so the slice may start before region.begin or end after
+ * region.end.
+ */
+EDS slice_eds(IndexedEdsReader & reader, const Region & region);
+
+/**
+ * Regions of a BED file, converted to 1-based inclusive coordinates. Throws
+ * std::runtime_error when the file cannot be read.
+ */
+std::vector<Region> read_bed(const std::string & filename);
+
+#endif //VCF2EDS_EDS_SLICE_H
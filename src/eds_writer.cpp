@@ -0,0 +1,141 @@
+#include "eds_writer.h"
+#include "eds_index.h"
+#include "reference.h"
+
+#include <algorithm>
+
+#include <endian.h>
+
+namespace
+{
+  /**
+   * {reference,variant,...} of a segment with reference() and variant(i).
+   */
+  template<class SegmentType>
+  void write_degenerate(EdsWriter & writer, const SegmentType & segment)
+  {
+    writer.put('{');
+    writer.write(segment.reference());
+    for (size_t i = 0; i < segment.variant_count(); ++i)
+    {
+      writer.put(',');
+      writer.write(segment.variant(i));
+    }
+    writer.put('}');
+  }
+}
+
+constexpr size_t EdsWriter::default_buffer_size;
+
+EdsWriter::EdsWriter(std::ostream & os, size_t buffer_size)
+  : os(os), buffer_size(std::max<size_t>(buffer_size, 64)), buffer(allocate_aligned(this->buffer_size)),
+    cursor(buffer.get()), end(buffer.get() + this->buffer_size)
+{ }
+
+EdsWriter::~EdsWriter()
+{
+  flush();
+}
+
+void EdsWriter::write_le32(uint32_t value)
+{
+  value = htole32(value);
+  write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void EdsWriter::write_le64(uint64_t value)
+{
+  value = htole64(value);
+  write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void EdsWriter::write_reference(const ContigSequence & source, size_t offset, size_t count)
+{
+  source.for_each_piece(offset, count, [this](const char * data, size_t length) { write(data, length); });
+}
+
+void EdsWriter::write_text(const Segment & segment)
+{
+  if (segment.is_degenerate())
+  {
+    put('{');
+    write(segment.get_reference().data(), segment.get_reference().length());
+    for (const auto & variant : segment.get_variants())
+    {
+      put(',');
+      write(variant.data(), variant.length());
+    }
+    put('}');
+  }
+  else if (segment.get_source())
+  {
+    write_reference(*segment.get_source(), segment.start_position() - 1, segment.length());
+  }
+  else
+  {
+    write(segment.get_reference().data(), segment.get_reference().length());
+  }
+}
+
+void EdsWriter::write_text(const SegmentView & segment)
+{
+  if (segment.is_degenerate())
+    write_degenerate(*this, segment);
+  else if (segment.is_span())
+    segment.write_reference(*this);
+  else
+    write(segment.reference());
+}
+
+void EdsWriter::write_text(const MappedSegment & segment)
+{
+  if (segment.is_degenerate())
+    write_degenerate(*this, segment);
+  else
+    write(segment.reference());
+}
+
+void EdsWriter::write_binary(const SegmentView & segment)
+{
+  write_le64(segment.start_position());
+  write_le32(static_cast<uint32_t>(segment.variant_count()));
+  write_le32(static_cast<uint32_t>(segment.length()));
+  if (segment.is_span())
+    segment.write_reference(*this);
+  else
+    write(segment.reference());
+
+  for (size_t v = 0; v < segment.variant_count(); ++v)
+  {
+    auto variant = segment.variant(v);
+    write_le32(static_cast<uint32_t>(variant.length));
+    write(variant);
+  }
+}
+
+uint64_t EdsWriter::tell()
+{
+  flush();
+  return EdsIndex::tell(os);
+}
+
+void EdsWriter::flush()
+{
+  if (cursor != buffer.get())
+    os.write(buffer.get(), cursor - buffer.get());
+  flushed += cursor - buffer.get();
+  cursor = buffer.get();
+}
+
+void EdsWriter::write_long(const char * data, size_t length)
+{
+  flush();
+  if (length >= buffer_size)
+  {
+    os.write(data, length);
+    flushed += length;
+    return;
+  }
+  std::memcpy(cursor, data, length);
+  cursor += length;
+}
@@ -0,0 +1,104 @@
+#ifndef VCF2EDS_EDS_WRITER_H
+#define VCF2EDS_EDS_WRITER_H
+
+#include "eds.h"
+#include "file_stream.h"
+#include "mapped_eds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+class ContigSequence;
+
+/**
+ * Formats EDS output into a large page aligned buffer which is handed to the stream
+ * in one write once full, instead of a formatted insertion per string. Strings longer
+ * than the buffer bypass it. Alternatives are written in the order the segment holds
+ * them, which is sorted by sequence, so equal input gives equal bytes.
+ */
+class EdsWriter
+{
+public:
+  static constexpr size_t default_buffer_size = 4 << 20;
+
+  explicit EdsWriter(std::ostream & os, size_t buffer_size = default_buffer_size);
+
+  /**
+   * Hands the buffered bytes to the stream.
+   */
+  ~EdsWriter();
+
+  EdsWriter(const EdsWriter &) = delete;
+  EdsWriter & operator = (const EdsWriter &) = delete;
+
+  void write(const char * data, size_t length)
+  {
+    if (length > static_cast<size_t>(end - cursor))
+    {
+      write_long(data, length);
+      return;
+    }
+    std::memcpy(cursor, data, length);
+    cursor += length;
+  }
+
+  void write(const StringRef & string)
+  {
+    write(string.data, string.length);
+  }
+
+  void put(char c)
+  {
+    if (cursor == end)
+      flush();
+    *cursor++ = c;
+  }
+
+  void write_le32(uint32_t value);
+  void write_le64(uint64_t value);
+
+  /**
+   * count bases of source starting at offset, as ContigSequence::write.
+   */
+  void write_reference(const ContigSequence & source, size_t offset, size_t count);
+
+  void write_text(const Segment & segment);
+  void write_text(const SegmentView & segment);
+  void write_text(const MappedSegment & segment);
+
+  /**
+   * Payload record of the segment in the binary format, see BinaryEdsHeader.
+   */
+  void write_binary(const SegmentView & segment);
+
+  /**
+   * Offset of the next byte in the stream as EdsIndex::tell reports it, flushes.
+   */
+  uint64_t tell();
+
+  /**
+   * Bytes written through the writer so far, buffered or not.
+   */
+  uint64_t size() const
+  {
+    return flushed + (cursor - buffer.get());
+  }
+
+  /**
+   * Hands the buffered bytes to the stream.
+   */
+  void flush();
+private:
+  void write_long(const char * data, size_t length);
+
+  std::ostream & os;
+  size_t buffer_size;
+  AlignedBuffer buffer;
+  char * cursor;
+  char * end;
+  uint64_t flushed = 0;
+};
+
+#endif //VCF2EDS_EDS_WRITER_H
@@ -0,0 +1,165 @@
+#include "file_stream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr size_t page_size = 4096;
+}
+
+AlignedBuffer allocate_aligned(size_t size)
+{
+  void * memory = nullptr;
+  if (posix_memalign(&memory, page_size, std::max<size_t>(size, 1)) != 0)
+    throw std::bad_alloc();
+  return AlignedBuffer(static_cast<char *>(memory), free);
+}
+
+constexpr size_t FileStreambuf::default_buffer_size;
+
+FileStreambuf::FileStreambuf(size_t buffer_size)
+  : buffer_size(std::max<size_t>(buffer_size, page_size)), buffer(allocate_aligned(this->buffer_size))
+{
+  setp(buffer.get(), buffer.get() + this->buffer_size);
+}
+
+FileStreambuf::~FileStreambuf()
+{
+  close();
+}
+
+bool FileStreambuf::open(const std::string & filename)
+{
+  if (fd >= 0)
+    return false;
+
+  fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  written = 0;
+  setp(buffer.get(), buffer.get() + buffer_size);
+  return fd >= 0;
+}
+
+bool FileStreambuf::close()
+{
+  if (fd < 0)
+    return true;
+
+  bool success = write_out(nullptr, 0);
+  success = ::close(fd) == 0 && success;
+  fd = -1;
+  return success;
+}
+
+bool FileStreambuf::is_open() const
+{
+  return fd >= 0;
+}
+
+bool FileStreambuf::write_out(const char * data, size_t count)
+{
+  if (fd < 0)
+    return false;
+
+  iovec parts[2] = {{pbase(), static_cast<size_t>(pptr() - pbase())}, {const_cast<char *>(data), count}};
+  iovec * part = parts;
+  iovec * end = parts + 2;
+  while (part != end)
+  {
+    if (part->iov_len == 0)
+    {
+      ++part;
+      continue;
+    }
+
+    ssize_t result = writev(fd, part, end - part);
+    if (result < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    // short writes continue where they stopped
+    written += result;
+    size_t done = result;
+    while (part != end && done >= part->iov_len)
+      done -= (part++)->iov_len;
+    if (part != end)
+    {
+      part->iov_base = static_cast<char *>(part->iov_base) + done;
+      part->iov_len -= done;
+    }
+  }
+
+  setp(buffer.get(), buffer.get() + buffer_size);
+  return true;
+}
+
+std::streamsize FileStreambuf::xsputn(const char * data, std::streamsize count)
+{
+  if (count <= epptr() - pptr())
+  {
+    std::memcpy(pptr(), data, count);
+    pbump(static_cast<int>(count));
+    return count;
+  }
+
+  return write_out(data, count) ? count : 0;
+}
+
+FileStreambuf::int_type FileStreambuf::overflow(int_type c)
+{
+  if (!write_out(nullptr, 0))
+    return traits_type::eof();
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+int FileStreambuf::sync()
+{
+  return write_out(nullptr, 0) ? 0 : -1;
+}
+
+FileStreambuf::pos_type FileStreambuf::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                               std::ios_base::openmode)
+{
+  if (fd < 0 || offset != 0 || direction != std::ios_base::cur)
+    return pos_type(off_type(-1));
+
+  return pos_type(off_type(written + (pptr() - pbase())));
+}
+
+ClosableOutputStream::ClosableOutputStream(std::streambuf * buffer)
+  : std::ostream(buffer)
+{ }
+
+FileOutputStream::FileOutputStream(const std::string & filename)
+  : ClosableOutputStream(&buffer)
+{
+  if (!buffer.open(filename))
+    setstate(std::ios::failbit);
+}
+
+bool FileOutputStream::is_open() const
+{
+  return buffer.is_open();
+}
+
+bool FileOutputStream::close()
+{
+  if (!buffer.close())
+    setstate(std::ios::badbit);
+  return !fail();
+}
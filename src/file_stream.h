@@ -0,0 +1,97 @@
+#ifndef VCF2EDS_FILE_STREAM_H
+#define VCF2EDS_FILE_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+using AlignedBuffer = std::unique_ptr<char, void (*)(void *)>;
+
+/**
+ * size bytes aligned to a memory page. Throws std::bad_alloc.
+ */
+AlignedBuffer allocate_aligned(size_t size);
+
+/**
+ * std::streambuf writing a file descriptor with write(2). Bytes are collected in a
+ * page aligned buffer, a write larger than the free space goes out together with the
+ * buffered bytes in one writev without being copied.
+ */
+class FileStreambuf : public std::streambuf
+{
+public:
+  static constexpr size_t default_buffer_size = 1 << 20;
+
+  explicit FileStreambuf(size_t buffer_size = default_buffer_size);
+  ~FileStreambuf() override;
+
+  FileStreambuf(const FileStreambuf &) = delete;
+  FileStreambuf & operator = (const FileStreambuf &) = delete;
+
+  /**
+   * Creates or truncates filename.
+   */
+  bool open(const std::string & filename);
+  bool close();
+  bool is_open() const;
+protected:
+  std::streamsize xsputn(const char * data, std::streamsize count) override;
+  int_type overflow(int_type c) override;
+
+  /**
+   * Writes the buffered bytes out.
+   */
+  int sync() override;
+
+  /**
+   * Only reports the current offset, which is what tellp needs.
+   */
+  pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override;
+private:
+  /**
+   * Writes the buffered bytes followed by count bytes of data, returns false on error.
+   */
+  bool write_out(const char * data, size_t count);
+
+  int fd = -1;
+  size_t buffer_size;
+  AlignedBuffer buffer;
+  // bytes written to fd
+  uint64_t written = 0;
+};
+
+/**
+ * Output stream of a file which holds back buffered bytes until it is closed. Only
+ * close tells whether everything reached the file, destroying the stream unclosed
+ * drops the error.
+ */
+class ClosableOutputStream : public std::ostream
+{
+public:
+  explicit ClosableOutputStream(std::streambuf * buffer);
+
+  /**
+   * Writes the buffered bytes and closes the file. Returns false when this or any
+   * earlier write failed.
+   */
+  virtual bool close() = 0;
+};
+
+/**
+ * Output stream of a plain file written through FileStreambuf.
+ */
+class FileOutputStream : public ClosableOutputStream
+{
+public:
+  explicit FileOutputStream(const std::string & filename);
+
+  bool is_open() const;
+  bool close() override;
+private:
+  FileStreambuf buffer;
+};
+
+#endif //VCF2EDS_FILE_STREAM_H
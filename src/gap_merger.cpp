@@ -0,0 +1,139 @@
+#include "gap_merger.h"
+#include "reference.h"
+
+namespace
+{
+  std::string reference_of(const Segment & segment)
+  {
+    if (segment.get_source())
+      return segment.get_source()->fetch(segment.start_position() - 1, segment.length());
+
+    return segment.get_reference();
+  }
+
+  struct AlleleTotals
+  {
+    size_t count;
+    size_t length;
+  };
+
+  /**
+   * Number and summed length of the alleles of a degenerate segment, reference included.
+   */
+  AlleleTotals allele_totals(const Segment & segment)
+  {
+    AlleleTotals totals{1, segment.get_reference().length()};
+    for (const auto & variant : segment.get_variants())
+    {
+      totals.count++;
+      totals.length += variant.length();
+    }
+    return totals;
+  }
+
+  /**
+   * Bytes the text output grows by when first, gap_length reference bases and second
+   * are written as one segment, {allele,...} with every combination, instead of apart.
+   */
+  size_t join_growth(const Segment & first, size_t gap_length, const Segment & second)
+  {
+    auto lhs = allele_totals(first);
+    auto rhs = allele_totals(second);
+    size_t combinations = lhs.count * rhs.count;
+
+    // each segment adds its braces and the commas between its alleles
+    size_t joined = lhs.length * rhs.count + combinations * gap_length + rhs.length * lhs.count
+                    + combinations + 1;
+    size_t separate = lhs.length + lhs.count + 1 + gap_length + rhs.length + rhs.count + 1;
+    return joined > separate ? joined - separate : 0;
+  }
+}
+
+GapMerger::GapMerger(size_t max_gap, size_t max_growth, SegmentSink sink)
+  : max_gap(max_gap), max_growth(max_growth), sink(std::move(sink))
+{ }
+
+void GapMerger::add(std::unique_ptr<Segment> && segment)
+{
+  if (!segment->is_degenerate())
+  {
+    if (pending && !gap && segment->length() <= max_gap)
+    {
+      gap = std::move(segment);
+      return;
+    }
+
+    flush();
+    sink(std::move(segment));
+    return;
+  }
+
+  if (pending)
+  {
+    if (join_growth(*pending, gap ? gap->length() : 0, *segment) <= max_growth)
+    {
+      pending = join(*pending, gap ? reference_of(*gap) : std::string(), *segment);
+      saved += gap ? 2 : 1;
+      gap.reset();
+      return;
+    }
+
+    flush();
+  }
+
+  pending = std::move(segment);
+}
+
+void GapMerger::flush()
+{
+  if (pending)
+    sink(std::move(pending));
+  if (gap)
+    sink(std::move(gap));
+
+  pending.reset();
+  gap.reset();
+}
+
+void GapMerger::finish()
+{
+  flush();
+}
+
+size_t GapMerger::saved_segments() const
+{
+  return saved;
+}
+
+std::unique_ptr<Segment> GapMerger::join(const Segment & first, const std::string & gap,
+                                         const Segment & second) const
+{
+  const std::string & first_reference = first.get_reference();
+  const std::string & second_reference = second.get_reference();
+
+  auto joined = std::make_unique<Segment>(first.start_position(), first_reference + gap + second_reference);
+  const std::string & reference = joined->get_reference();
+
+  // reference of each side followed by its alternatives
+  auto for_each_allele = [](const Segment & segment, const auto & callback)
+  {
+    callback(segment.get_reference().data(), segment.get_reference().length());
+    for (const auto & variant : segment.get_variants())
+      callback(variant.data(), variant.length());
+  };
+
+  std::string allele;
+  for_each_allele(first, [&](const char * prefix, size_t prefix_length)
+  {
+    for_each_allele(second, [&](const char * suffix, size_t suffix_length)
+    {
+      allele.assign(prefix, prefix_length);
+      allele += gap;
+      allele.append(suffix, suffix_length);
+      if (allele != reference)
+        joined->add_variant(allele);
+    });
+  });
+
+  return joined;
+}
@@ -0,0 +1,48 @@
+#ifndef VCF2EDS_GAP_MERGER_H
+#define VCF2EDS_GAP_MERGER_H
+
+#include "converter.h"
+#include "eds.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/**
+ * Sits between the cluster emitter and a sink and joins degenerate segments separated
+ * by at most max_gap reference bases. The joined segment lists every combination of
+ * the alleles (reference included) of both sides around the gap, so it is always
+ * larger than the two segments and the gap written apart. Two segments are joined
+ * only while that growth of the text output stays within max_growth bytes.
+ */
+class GapMerger
+{
+public:
+  GapMerger(size_t max_gap, size_t max_growth, SegmentSink sink);
+
+  void add(std::unique_ptr<Segment> && segment);
+
+  /**
+   * Passes the segments held back to the sink.
+   */
+  void finish();
+
+  /**
+   * Number of segments that did not have to be emitted thanks to joining.
+   */
+  size_t saved_segments() const;
+private:
+  void flush();
+  std::unique_ptr<Segment> join(const Segment & first, const std::string & gap, const Segment & second) const;
+
+  size_t max_gap;
+  size_t max_growth;
+  SegmentSink sink;
+
+  // last degenerate segment and the reference segment following it
+  std::unique_ptr<Segment> pending;
+  std::unique_ptr<Segment> gap;
+  size_t saved = 0;
+};
+
+#endif //VCF2EDS_GAP_MERGER_H
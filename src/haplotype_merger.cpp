@@ -0,0 +1,219 @@
+#include "haplotype_merger.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+  // polynomial hash modulo the Mersenne prime 2^61 - 1
+  constexpr uint64_t modulus = (1ull << 61) - 1;
+  constexpr uint64_t base = 0x9E3779B97F4A7C15ull % modulus;
+
+  __extension__ typedef unsigned __int128 uint128_t;
+
+  uint64_t mul_mod(uint64_t lhs, uint64_t rhs)
+  {
+    uint128_t product = static_cast<uint128_t>(lhs) * rhs;
+    uint64_t result = static_cast<uint64_t>(product & modulus) + static_cast<uint64_t>(product >> 61);
+    return result >= modulus ? result - modulus : result;
+  }
+
+  uint64_t add_mod(uint64_t lhs, uint64_t rhs)
+  {
+    uint64_t result = lhs + rhs;
+    return result >= modulus ? result - modulus : result;
+  }
+
+  uint64_t sub_mod(uint64_t lhs, uint64_t rhs)
+  {
+    return lhs >= rhs ? lhs - rhs : lhs + modulus - rhs;
+  }
+
+  uint64_t hash_string(const std::string & string)
+  {
+    uint64_t value = 0;
+    for (char c : string)
+      value = add_mod(mul_mod(value, base), static_cast<unsigned char>(c));
+    return value;
+  }
+}
+
+void HaplotypeMerger::add(const VcfRecord & record)
+{
+  size_t record_end = record.position + record.ref.length() - 1;
+  if (records.empty())
+  {
+    start = record.position;
+    end = record_end;
+    reference = record.ref;
+  }
+  else if (record.position < start)
+  {
+    throw std::invalid_argument("Records of a cluster must come in position order");
+  }
+  else if (record_end > end)
+  {
+    reference.append(record.ref, record.ref.length() - (record_end - end), std::string::npos);
+    end = record_end;
+  }
+
+  records.push_back(Record{record.position, record.ref.length(), record.alt, record.haplotypes, record.phased});
+}
+
+size_t HaplotypeMerger::end_position() const
+{
+  return end;
+}
+
+bool HaplotypeMerger::haplotype_pieces(size_t haplotype, std::vector<Piece> & pieces) const
+{
+  pieces.clear();
+  size_t cursor = start;
+  for (uint32_t i = 0; i < records.size(); ++i)
+  {
+    const auto & record = records[i];
+    int32_t allele = record.haplotypes[haplotype];
+    if (allele <= 0)
+      continue;
+    if (static_cast<size_t>(allele) > record.alt.size())
+      return false;
+
+    const auto & alt = record.alt[allele - 1];
+    if (alt == "*")
+      continue;
+    if (alt.empty() || alt[0] == '<' || record.position < cursor)
+      return false;
+
+    pieces.push_back(Piece(i, allele - 1));
+    cursor = record.position + record.length;
+  }
+
+  return true;
+}
+
+uint64_t HaplotypeMerger::hash(const std::vector<Piece> & pieces) const
+{
+  uint64_t value = 0;
+  auto append_reference = [&](size_t from, size_t to)
+  {
+    uint64_t span = sub_mod(prefix_hash[to], mul_mod(prefix_hash[from], powers[to - from]));
+    value = add_mod(mul_mod(value, powers[to - from]), span);
+  };
+
+  size_t cursor = 0;
+  for (const auto & piece : pieces)
+  {
+    const auto & record = records[piece.first];
+    append_reference(cursor, record.position - start);
+    value = add_mod(mul_mod(value, powers[record.alt[piece.second].length()]), alt_hash[piece.first][piece.second]);
+    cursor = record.position - start + record.length;
+  }
+  append_reference(cursor, reference.length());
+
+  return value;
+}
+
+void HaplotypeMerger::build(const std::vector<Piece> & pieces, std::string & output) const
+{
+  output.clear();
+  size_t cursor = 0;
+  for (const auto & piece : pieces)
+  {
+    const auto & record = records[piece.first];
+    output.append(reference, cursor, record.position - start - cursor);
+    output.append(record.alt[piece.second]);
+    cursor = record.position - start + record.length;
+  }
+  output.append(reference, cursor, std::string::npos);
+}
+
+std::unique_ptr<Segment> HaplotypeMerger::finish()
+{
+  if (records.empty() || records[0].haplotypes.empty())
+    return nullptr;
+
+  size_t haplotype_count = records[0].haplotypes.size();
+  size_t longest = reference.length();
+  for (const auto & record : records)
+  {
+    if (record.haplotypes.size() != haplotype_count || (!record.phased && records.size() > 1))
+      return nullptr;
+    for (const auto & alt : record.alt)
+      longest = std::max(longest, alt.length());
+  }
+
+  powers.assign(longest + 1, 1);
+  for (size_t i = 1; i <= longest; ++i)
+    powers[i] = mul_mod(powers[i - 1], base);
+
+  prefix_hash.assign(reference.length() + 1, 0);
+  for (size_t i = 0; i < reference.length(); ++i)
+    prefix_hash[i + 1] = add_mod(mul_mod(prefix_hash[i], base), static_cast<unsigned char>(reference[i]));
+
+  alt_hash.clear();
+  for (const auto & record : records)
+  {
+    alt_hash.emplace_back();
+    for (const auto & alt : record.alt)
+      alt_hash.back().push_back(hash_string(alt));
+  }
+
+  // distinct haplotypes, the first one is the reference
+  struct Haplotype
+  {
+    std::vector<Piece> pieces;
+    std::string sequence;
+  };
+  std::vector<Haplotype> distinct;
+  distinct.push_back(Haplotype{{}, reference});
+  std::unordered_map<uint64_t, std::vector<size_t>> by_hash;
+  by_hash[prefix_hash.back()].push_back(0);
+
+  std::vector<Piece> pieces;
+  std::string candidate;
+  for (size_t haplotype = 0; haplotype < haplotype_count; ++haplotype)
+  {
+    if (!haplotype_pieces(haplotype, pieces))
+      return nullptr;
+
+    // equal hashes are confirmed by the alleles carried, or by the sequence itself
+    // when different alleles happen to spell the same haplotype
+    auto & bucket = by_hash[hash(pieces)];
+    bool built = false;
+    bool found = false;
+    for (size_t idx : bucket)
+    {
+      if (distinct[idx].pieces == pieces)
+      {
+        found = true;
+        break;
+      }
+
+      if (!built)
+      {
+        build(pieces, candidate);
+        built = true;
+      }
+      if (distinct[idx].sequence == candidate)
+      {
+        found = true;
+        break;
+      }
+    }
+    if (found)
+      continue;
+
+    if (!built)
+      build(pieces, candidate);
+    bucket.push_back(distinct.size());
+    distinct.push_back(Haplotype{pieces, candidate});
+  }
+
+  auto cluster = std::make_unique<Segment>(start);
+  cluster->add_reference(reference);
+  for (size_t i = 1; i < distinct.size(); ++i)
+    cluster->add_variant(distinct[i].sequence);
+
+  return cluster;
+}
@@ -0,0 +1,68 @@
+#ifndef VCF2EDS_HAPLOTYPE_MERGER_H
+#define VCF2EDS_HAPLOTYPE_MERGER_H
+
+#include "eds.h"
+#include "vcf_reader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Merges an overlap cluster into the haplotypes observed in the sample genotypes.
+ * Instead of padding every alternative with reference, each haplotype applies the
+ * alleles it carries to the cluster reference, and the segment lists the distinct
+ * results. Haplotypes equal to the reference are dropped. Duplicates are found by a
+ * rolling hash computed from the pieces of a haplotype without building it.
+ *
+ * Missing calls count as reference and "*" alleles of spanning deletions as no
+ * change. When the cluster has no genotypes, unphased heterozygous calls in more
+ * than one record, or alleles of one haplotype that overlap, finish returns nullptr.
+ */
+class HaplotypeMerger
+{
+public:
+  /**
+   * Adds a record overlapping the cluster. Records are expected in position order.
+   */
+  void add(const VcfRecord & record);
+
+  size_t end_position() const;
+
+  /**
+   * Returns the merged cluster, or nullptr when the haplotypes cannot be resolved.
+   */
+  std::unique_ptr<Segment> finish();
+private:
+  struct Record
+  {
+    size_t position;
+    size_t length;
+    std::vector<std::string> alt;
+    std::vector<int32_t> haplotypes;
+    bool phased;
+  };
+
+  /**
+   * Allele carried by a haplotype, as (record, alt index).
+   */
+  using Piece = std::pair<uint32_t, uint32_t>;
+
+  bool haplotype_pieces(size_t haplotype, std::vector<Piece> & pieces) const;
+  uint64_t hash(const std::vector<Piece> & pieces) const;
+  void build(const std::vector<Piece> & pieces, std::string & output) const;
+
+  size_t start = 0;
+  size_t end = 0;
+  std::string reference;
+  std::vector<Record> records;
+
+  // rolling hash of the reference prefixes and powers of the base
+  std::vector<uint64_t> prefix_hash;
+  std::vector<uint64_t> powers;
+  std::vector<std::vector<uint64_t>> alt_hash;
+};
+
+#endif //VCF2EDS_HAPLOTYPE_MERGER_H
@@ -0,0 +1,24 @@
+#include "hts_thread_pool.h"
+
+#include <stdexcept>
+
+HtsThreadPool::HtsThreadPool(int threads)
+{
+  if (threads < 2)
+    return;
+
+  pool = hts_tpool_init(threads);
+  if (!pool)
+    throw std::runtime_error("Could not create thread pool");
+}
+
+HtsThreadPool::~HtsThreadPool()
+{
+  if (pool)
+    hts_tpool_destroy(pool);
+}
+
+hts_tpool * HtsThreadPool::get() const
+{
+  return pool;
+}
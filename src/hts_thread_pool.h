@@ -0,0 +1,24 @@
+#ifndef VCF2EDS_HTS_THREAD_POOL_H
+#define VCF2EDS_HTS_THREAD_POOL_H
+
+#include <htslib/thread_pool.h>
+
+/**
+ * Owns an htslib thread pool shared by all BGZF streams of one conversion.
+ * With less than two threads no pool is created and readers stay single-threaded.
+ */
+class HtsThreadPool
+{
+public:
+  explicit HtsThreadPool(int threads);
+  ~HtsThreadPool();
+
+  HtsThreadPool(const HtsThreadPool &) = delete;
+  HtsThreadPool & operator = (const HtsThreadPool &) = delete;
+
+  hts_tpool * get() const;
+private:
+  hts_tpool * pool = nullptr;
+};
+
+#endif //VCF2EDS_HTS_THREAD_POOL_H
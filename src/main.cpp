@@ -1,18 +1,33 @@
+#include "converter.h"
+#include "bgzf_stream.h"
 #include "eds.h"
+#include "eds_format.h"
+#include "eds_index.h"
+#include "eds_pipeline.h"
+#include "eds_slice.h"
+#include "eds_writer.h"
+#include "file_stream.h"
+#include "gap_merger.h"
+#include "hts_thread_pool.h"
+#include "mapped_eds.h"
+#include "merged_reader.h"
+#include "reference.h"
+#include "streaming_builder.h"
+#include "vcf_reader.h"
 #include "utils/cxxopts.h"
-#include "utils/kseq.h"
 
-#include <zlib.h>
-//#include <stdio.h>
 #include <vcflib/Variant.h>
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <string>
 #include <map>
 
-KSEQ_INIT(gzFile, gzread)
-
 void experiments(const cxxopts::ParseResult & result, std::vector<std::string> & vcf_files)
 {
   std::string reference_file = result["r"].as<std::string>();
@@ -84,7 +99,7 @@ void experiments(const cxxopts::ParseResult & result, std::vector<std::string> &
 
       std::unique_ptr<Segment> segment = std::make_unique<Segment>(variant.position);
       segment->add_reference(variant.ref);
-      segment->add_variants(begin(variant.alt), end(variant.alt));
+      segment->intern_variants(begin(variant.alt), end(variant.alt));
 
       auto segment_in_map = variants_pos.find(segment->start_position());
       if (segment_in_map != variants_pos.end())
@@ -107,7 +122,223 @@ void experiments(const cxxopts::ParseResult & result, std::vector<std::string> &
   std::cout << "avg per variant = " << static_cast<double>(number_of_samples) / number_of_variants << std::endl;
 }
 
-void vcf2eds_exec(const cxxopts::ParseResult & result, std::vector<std::string> & vcf_files)
+std::unique_ptr<Reference> open_reference(const std::string & reference_file, hts_tpool * pool)
+{
+  auto reference = Reference::open(reference_file, pool);
+  if (!reference)
+    std::cout << "Could not open given reference file: " << reference_file << std::endl;
+
+  return reference;
+}
+
+/**
+ * Reference opened on its own thread, so that reading it overlaps with reading the VCFs.
+ */
+class ReferenceLoader
+{
+public:
+  ReferenceLoader(const std::string & filename, hts_tpool * pool)
+    : loading(std::async(std::launch::async, open_reference, filename, pool))
+  { }
+
+  /**
+   * Waits for the reference, nullptr when it could not be opened.
+   */
+  const Reference * get()
+  {
+    if (loading.valid())
+      reference = loading.get();
+    return reference.get();
+  }
+private:
+  std::future<std::unique_ptr<Reference>> loading;
+  std::unique_ptr<Reference> reference;
+};
+
+/**
+ * Opens the output file, BGZF compressed on the thread pool with -z.
+ */
+std::unique_ptr<ClosableOutputStream> open_output(const cxxopts::ParseResult & result, const std::string & filename,
+                                                  hts_tpool * pool)
+{
+  if (result["z"].as<bool>())
+    return std::make_unique<BgzfOutputStream>(filename, pool);
+
+  return std::make_unique<FileOutputStream>(filename);
+}
+
+/**
+ * Closes an output of open_output, reports when it could not be written completely.
+ */
+bool close_output(ClosableOutputStream & output, const std::string & filename)
+{
+  if (output.close())
+    return true;
+
+  std::cout << "Could not write " << filename << std::endl;
+  return false;
+}
+
+/**
+ * Closes and deletes an output of open_output left incomplete, together with the .gzi
+ * written next to BGZF output.
+ */
+void discard_output(const cxxopts::ParseResult & result, ClosableOutputStream & output, const std::string & filename)
+{
+  output.close();
+  std::remove(filename.c_str());
+  if (result["z"].as<bool>())
+    std::remove((filename + ".gzi").c_str());
+}
+
+/**
+ * With -x, the coordinate index to fill while the output is written, nullptr otherwise.
+ */
+std::unique_ptr<EdsIndex> output_index(const cxxopts::ParseResult & result, EDS::Format format)
+{
+  if (!result["x"].as<bool>())
+    return nullptr;
+
+  return std::make_unique<EdsIndex>(std::max(result["index-stride"].as<int>(), 1), format == EDS::Format::binary);
+}
+
+/**
+ * Writes the index next to the output file, the output should be complete by then.
+ */
+void save_index(const EdsIndex * index, const std::string & output_file)
+{
+  if (index && !index->save(output_file + ".edsi"))
+    std::cout << "Could not write index " << output_file << ".edsi" << std::endl;
+}
+
+/**
+ * With -m, puts a GapMerger in front of the sink and returns it, nullptr otherwise.
+ */
+std::unique_ptr<GapMerger> gap_merger(const cxxopts::ParseResult & result, SegmentSink & sink)
+{
+  if (!result.count("m"))
+    return nullptr;
+
+  auto gaps = std::make_unique<GapMerger>(std::max(result["m"].as<int>(), 0),
+                                          std::max(result["merge-limit"].as<int>(), 0), std::move(sink));
+  GapMerger * gaps_ptr = gaps.get();
+  sink = [gaps_ptr](std::unique_ptr<Segment> && segment) { gaps_ptr->add(std::move(segment)); };
+  return gaps;
+}
+
+/**
+ * Streams sorted VCF records straight into the output file.
+ * Returns false when the input turns out to be unsorted, the output is removed then.
+ */
+bool vcf2eds_streaming(const cxxopts::ParseResult & result, std::vector<std::string> & vcf_files,
+                       VcfReader::Backend backend, hts_tpool * pool, ReferenceLoader & reference_loader,
+                       const std::string & output_file)
+{
+  bool phased = result["p"].as<bool>();
+
+  // every input is parsed on its own thread, several inputs are merged by position
+  std::vector<std::unique_ptr<VcfReader>> readers;
+  for (auto & vcf_filename : vcf_files)
+  {
+    auto vcf_file = VcfReader::open(vcf_filename, backend, pool, phased);
+    if (!vcf_file->is_open())
+    {
+      std::cout << "Could not open given VCF file: " << vcf_filename << std::endl;
+      return true;
+    }
+
+    readers.push_back(std::make_unique<PrefetchReader>(std::move(vcf_file)));
+  }
+
+  // the readers fill their queues while the reference is being read
+  const Reference * reference = reference_loader.get();
+  if (!reference)
+    return true;
+
+  std::unique_ptr<VcfReader> input;
+  MergedVcfReader * merged = nullptr;
+  if (readers.size() == 1)
+  {
+    input = std::move(readers.front());
+  }
+  else
+  {
+    auto merged_reader = std::make_unique<MergedVcfReader>(std::move(readers));
+    merged = merged_reader.get();
+    input = std::move(merged_reader);
+  }
+
+  // the offset table of the binary format precedes the segments, so binary output is
+  // collected first - non-degenerate segments stay spans of the reference meanwhile.
+  // Text is formatted and written on stage threads while records are merged.
+  auto format = EDS::parse_format(result["f"].as<std::string>());
+  auto output = open_output(result, output_file, pool);
+  auto index = output_index(result, format);
+  EDS eds;
+  std::unique_ptr<PipelinedEdsWriter> writer;
+  SegmentSink sink;
+  if (format == EDS::Format::binary)
+  {
+    sink = [&eds](std::unique_ptr<Segment> && segment) { eds.add_segment(std::move(segment)); };
+  }
+  else
+  {
+    writer = std::make_unique<PipelinedEdsWriter>(*output, index.get());
+    sink = [&writer](std::unique_ptr<Segment> && segment) { writer->add(std::move(segment)); };
+  }
+  auto gaps = gap_merger(result, sink);
+  StreamingBuilder builder(*reference, sink, phased);
+
+  try
+  {
+    VcfRecord record;
+    while (input->next(record))
+    {
+      if (eds.contig().empty())
+      {
+        eds.set_contig(record.chromosome);
+        if (index && format == EDS::Format::text)
+          index->begin_contig(record.chromosome);
+      }
+      builder.add_variant(record);
+    }
+    builder.finish();
+    if (gaps)
+      gaps->finish();
+    if (writer)
+      writer->finish();
+  }
+  catch (const UnsortedInputError & e)
+  {
+    // nothing of the partial output is kept, the index has not been written yet
+    if (writer)
+      writer->abort();
+    discard_output(result, *output, output_file);
+    std::cout << e.what() << std::endl;
+    return false;
+  }
+
+  if (format == EDS::Format::binary)
+    eds.save(*output, format, index.get(), result["threads"].as<int>());
+  if (!close_output(*output, output_file))
+    return true;
+  save_index(index.get(), output_file);
+
+  std::cout << "count " << builder.variant_positions() << std::endl;
+  std::cout << "largest cluster " << builder.max_cluster_size() << std::endl;
+  if (phased)
+  {
+    std::cout << "clusters from haplotypes " << builder.phased_clusters() << std::endl;
+    std::cout << "clusters without usable phase " << builder.unphased_clusters() << std::endl;
+  }
+  if (merged)
+    std::cout << "duplicates " << merged->duplicates() << std::endl;
+  if (gaps)
+    std::cout << "segments saved by merging " << gaps->saved_segments() << std::endl;
+  return true;
+}
+
+int vcf2eds_exec(const cxxopts::ParseResult & result, std::vector<std::string> & vcf_files)
 {
   std::string reference_file = result["r"].as<std::string>();
   std::string output_file = result["o"].as<std::string>();
@@ -118,105 +349,372 @@ void vcf2eds_exec(const cxxopts::ParseResult & result, std::vector<std::string>
             std::ostream_iterator<std::string>(std::cout, "\n"));
   std::cout << "--------------------------" << std::endl;
 
-  std::map<size_t, std::unique_ptr<Segment>> variants_pos;
+  auto backend = VcfReader::parse_backend(result["b"].as<std::string>());
+  HtsThreadPool thread_pool(result["threads"].as<int>());
 
-  for (auto & vcf_filename : vcf_files)
+  // indexed references are opened without reading any sequence, others are read
+  // meanwhile the VCFs are
+  ReferenceLoader reference(reference_file, thread_pool.get());
+
+  // haplotypes are followed record by record, which needs sorted input
+  bool phased = result["p"].as<bool>();
+  if (result["s"].as<bool>() || phased)
   {
-    vcflib::VariantCallFile vcf_file;
-    vcf_file.open(vcf_filename);
-    if (!vcf_file.is_open())
+    std::cout << "--------------- creating EDS -----------------" << std::endl;
+    if (vcf2eds_streaming(result, vcf_files, backend, thread_pool.get(), reference, output_file))
+      return 0;
+
+    if (phased)
     {
-      std::cout << "Could not open given VCF file: " << std::endl;
-      return;
+      std::cout << "Phased merge needs coordinate sorted VCF input" << std::endl;
+      return 1;
     }
+    std::cout << "falling back to in-memory conversion" << std::endl;
+  }
 
-    vcflib::Variant variant(vcf_file);
-    while (vcf_file.getNextVariant(variant))
-    {
-      if (variant.alt[0][0] == '<')
-        continue;
+  VariantMap variants_pos;
+  std::string contig;
 
-      std::unique_ptr<Segment> segment = std::make_unique<Segment>(variant.position);
-      segment->add_reference(variant.ref);
-      segment->add_variants(begin(variant.alt), end(variant.alt));
+  for (auto & vcf_filename : vcf_files)
+  {
+    auto vcf_file = VcfReader::open(vcf_filename, backend, thread_pool.get());
+    if (!vcf_file->is_open())
+    {
+      std::cout << "Could not open given VCF file: " << vcf_filename << std::endl;
+      return 1;
+    }
 
-      auto segment_in_map = variants_pos.find(segment->start_position());
-      if (segment_in_map != variants_pos.end())
-      {
-        segment_in_map->second->merge(*segment);
-      }
-      else
+    // records are parsed on the prefetch thread while this one inserts them
+    vcf_file = std::make_unique<PrefetchReader>(std::move(vcf_file));
+    VcfRecord record;
+    while (vcf_file->next(record))
+    {
+      if (contig.empty())
+        contig = record.chromosome;
+      else if (record.chromosome != contig)
       {
-        variants_pos.insert(std::make_pair(segment->start_position(), std::move(segment)));
+        std::cout << "VCF holds more than one contig (" << contig << ", " << record.chromosome
+                  << ") - use -c to convert contigs separately" << std::endl;
+        return 1;
       }
+
+      add_variant(variants_pos, record);
     }
   }
 
   std::cout << "--------------- creating EDS -----------------" << std::endl;
+  if (!reference.get())
+    return 1;
+
+  const ContigSequence * sequence = reference.get()->resolve(contig);
+  if (!sequence)
+  {
+    std::cout << "Contig " << contig << " is missing in the reference" << std::endl;
+    return 1;
+  }
+
+  // text is formatted and written on stage threads while the clusters are merged, the
+  // offset table of the binary format needs the whole EDS first
+  auto format = EDS::parse_format(result["f"].as<std::string>());
+  auto index = output_index(result, format);
+  auto output = open_output(result, output_file, thread_pool.get());
   EDS eds;
+  eds.set_contig(contig);
+  std::unique_ptr<PipelinedEdsWriter> writer;
+  SegmentSink sink;
+  if (format == EDS::Format::binary)
+  {
+    sink = [&eds](std::unique_ptr<Segment> && segment) { eds.add_segment(std::move(segment)); };
+  }
+  else
+  {
+    if (index)
+      index->begin_contig(contig);
+    writer = std::make_unique<PipelinedEdsWriter>(*output, index.get());
+    sink = [&writer](std::unique_ptr<Segment> && segment) { writer->add(std::move(segment)); };
+  }
 
-  // read reference sequence
-  gzFile file_ptr;
-  kseq_t *sequence;
-  int l;
-  file_ptr = gzopen(reference_file.c_str(), "r");
-  sequence = kseq_init(file_ptr);
+  std::cout << "count " << variants_pos.size() << std::endl;
+  auto gaps = gap_merger(result, sink);
+  build_eds(variants_pos, *sequence, sink);
+  if (gaps)
+  {
+    gaps->finish();
+    std::cout << "segments saved by merging " << gaps->saved_segments() << std::endl;
+  }
 
-  std::string reference_buffer;
-  size_t processed_pos = 1;
+  if (writer)
+    writer->finish();
+  else
+    eds.save(*output, format, index.get(), result["threads"].as<int>());
+  if (!close_output(*output, output_file))
+    return 1;
+  save_index(index.get(), output_file);
+  return 0;
+}
 
-  while ((l = kseq_read(sequence)) >= 0)
+std::string contig_output_file(const std::string & output_file, const std::string & contig)
+{
+  auto extension = output_file.rfind(".eds");
+  if (extension != std::string::npos && extension + 4 == output_file.length())
+    return output_file.substr(0, extension) + "." + contig + ".eds";
+
+  return output_file + "." + contig;
+}
+
+void vcf2eds_contigs_exec(const cxxopts::ParseResult & result, std::vector<std::string> & vcf_files)
+{
+  std::string reference_file = result["r"].as<std::string>();
+  std::string output_file = result["o"].as<std::string>();
+  bool split = result["split"].as<bool>();
+
+  std::cout << "vcf2eds - header\n";
+  std::cout << "ref: " << reference_file << " out: " << output_file << "\nvcf:\n";
+  std::copy(vcf_files.begin(), vcf_files.end(),
+            std::ostream_iterator<std::string>(std::cout, "\n"));
+  std::cout << "--------------------------" << std::endl;
+
+  if (VcfReader::parse_backend(result["b"].as<std::string>()) != VcfReader::Backend::htslib)
   {
-    reference_buffer.append(sequence->seq.s, sequence->seq.l);
+    std::cout << "Conversion by contigs requires the htslib backend" << std::endl;
+    return;
   }
 
-  // merge all overlapping segments in variants_pos
-  std::cout << "count " << variants_pos.size() << std::endl;
-  for (auto iter = variants_pos.begin(); iter != variants_pos.end(); ++iter)
+  HtsThreadPool thread_pool(result["threads"].as<int>());
+
+  auto reference = open_reference(reference_file, thread_pool.get());
+  if (!reference)
+    return;
+
+  ContigConverter converter(vcf_files, *reference, thread_pool.get(), result["shards"].as<int>());
+  if (result.count("m"))
+    converter.set_gap_merging(std::max(result["m"].as<int>(), 0), std::max(result["merge-limit"].as<int>(), 0));
+  std::vector<std::string> contigs;
+  for (const auto & contig : converter.contigs())
   {
-    auto segment_ptr = std::move(iter->second);
+    if (reference->find(contig))
+      contigs.push_back(contig);
+    else
+      std::cout << "skipping contig " << contig << " - not in reference" << std::endl;
+  }
 
-    // 1. create segment of preceeding normal reference and add to EDS
-    if (processed_pos < segment_ptr->start_position())
+  std::cout << "--------------- creating EDS -----------------" << std::endl;
+  auto format = EDS::parse_format(result["f"].as<std::string>());
+  std::unique_ptr<ClosableOutputStream> output;
+  std::unique_ptr<EdsIndex> index;
+  if (!split)
+  {
+    output = open_output(result, output_file, thread_pool.get());
+    index = output_index(result, format);
+  }
+
+  converter.run(contigs, result["j"].as<int>(), [&](const std::string & contig, EDS && eds)
+  {
+    std::cout << "contig " << contig << " done" << std::endl;
+    if (split)
+    {
+      std::string contig_file = contig_output_file(output_file, contig);
+      auto contig_index = output_index(result, format);
+      auto contig_output = open_output(result, contig_file, thread_pool.get());
+      eds.save(*contig_output, format, contig_index.get(), result["threads"].as<int>());
+      if (close_output(*contig_output, contig_file))
+        save_index(contig_index.get(), contig_file);
+    }
+    else
     {
-      eds.add_segment(std::make_unique<Segment>(
-              processed_pos,
-              reference_buffer.substr(processed_pos - 1, segment_ptr->start_position() - processed_pos)
-      ));
+      eds.save(*output, format, index.get(), result["threads"].as<int>());
     }
+  });
+  if (output && close_output(*output, output_file))
+    save_index(index.get(), output_file);
 
-    // 2. if any following segments overlap - merge
-    auto iter_tmp = iter;
-    while (++iter_tmp != variants_pos.end()
-            && iter_tmp->second->start_position() <= segment_ptr->end_position())
+  if (result.count("m"))
+    std::cout << "segments saved by merging " << converter.saved_segments() << std::endl;
+}
+
+/**
+ * vcf2eds convert - rewrites an EDS file in the other format, the input format is detected.
+ */
+int convert_exec(int argc, char * argv[])
+{
+  cxxopts::Options options("vcf2eds convert", "Converts EDS files between the text and binary format.");
+
+  options.add_options()
+          ("i,input", "File name of the EDS to convert", cxxopts::value<std::string>())
+          ("o,output", "File name of the converted EDS", cxxopts::value<std::string>())
+          ("f,format", "Format of the converted EDS (text, binary)", cxxopts::value<std::string>()->default_value("binary"))
+          ("contig", "Contig name stored in binary output when the input does not carry one", cxxopts::value<std::string>())
+          ("z,bgzf", "Compress the output with BGZF", cxxopts::value<bool>()->default_value("false"))
+          ("x,index", "Write a coordinate index (.edsi) next to the output", cxxopts::value<bool>()->default_value("false"))
+          ("index-stride", "Reference bases between checkpoints of the index", cxxopts::value<int>()->default_value(std::to_string(EdsIndex::default_stride)))
+          ("threads", "Number of threads for parsing text input, formatting the output and for BGZF compression and decompression", cxxopts::value<int>()->default_value("1"))
+          ;
+
+  auto result = options.parse(argc, argv);
+  if (!result.count("i") || !result.count("o"))
+  {
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  HtsThreadPool thread_pool(result["threads"].as<int>());
+  std::string input_file = result["i"].as<std::string>();
+
+  // uncompressed binary to text is written straight from the mapped input
+  auto format = EDS::parse_format(result["f"].as<std::string>());
+  std::ifstream plain(input_file, std::ios::binary);
+  if (format == EDS::Format::text && BinaryEdsHeader::detect(plain))
+  {
+    auto mapped = MappedEds::open(input_file);
+    if (mapped)
     {
-      segment_ptr->merge(*(iter_tmp->second));
-      iter = iter_tmp;
+      auto index = output_index(result, format);
+      auto output = open_output(result, result["o"].as<std::string>(), thread_pool.get());
+      auto writer = std::make_unique<EdsWriter>(*output);
+      for (size_t contig = 0; contig < mapped->contig_count(); ++contig)
+      {
+        if (index)
+          index->begin_contig(mapped->contig(contig));
+        for (size_t idx = mapped->first_segment(contig); idx < mapped->first_segment(contig + 1); ++idx)
+        {
+          auto segment = mapped->segment(idx);
+          if (index)
+            index->add(*writer, segment);
+          writer->write_text(segment);
+        }
+      }
+      writer.reset();
+      if (!close_output(*output, result["o"].as<std::string>()))
+        return 1;
+      save_index(index.get(), result["o"].as<std::string>());
+      std::cout << "segments " << mapped->size() << std::endl;
+      return 0;
     }
+  }
 
-    processed_pos = segment_ptr->end_position() + 1;
-    eds.add_segment(std::move(segment_ptr));
+  EDS eds;
+  if (!eds.load_file(input_file, result["threads"].as<int>(), thread_pool.get()))
+  {
+    std::cout << "Could not open given EDS file: " << input_file << std::endl;
+    return 1;
   }
+  if (eds.contig().empty() && result.count("contig"))
+    eds.set_contig(result["contig"].as<std::string>());
+
+  auto index = output_index(result, format);
+  auto output = open_output(result, result["o"].as<std::string>(), thread_pool.get());
+  eds.save(*output, format, index.get(), result["threads"].as<int>());
+  if (!close_output(*output, result["o"].as<std::string>()))
+    return 1;
+  save_index(index.get(), result["o"].as<std::string>());
+  std::cout << "segments " << eds.size() << std::endl;
+  return 0;
+}
 
-  kseq_destroy(sequence);
-  gzclose(file_ptr);
+/**
+ * vcf2eds slice - extracts regions of an indexed EDS file.
+ */
+int slice_exec(int argc, char * argv[])
+{
+  cxxopts::Options options("vcf2eds slice", "Extracts regions of an EDS file indexed with -x.");
 
-  // save to output file
-  std::ofstream output(output_file);
-  eds.save(output);
+  std::vector<std::string> region_names;
+  options.add_options()
+          ("i,input", "File name of the indexed EDS", cxxopts::value<std::string>())
+          ("o,output", "File name of the extracted EDS", cxxopts::value<std::string>())
+          ("r,region", "Regions as contig:begin-end, 1-based and inclusive", cxxopts::value<std::vector<std::string>>(region_names))
+          ("bed", "BED file with the regions", cxxopts::value<std::string>())
+          ("f,format", "Format of the extracted EDS (text, binary)", cxxopts::value<std::string>()->default_value("text"))
+          ("z,bgzf", "Compress the output with BGZF", cxxopts::value<bool>()->default_value("false"))
+          ("x,index", "Write a coordinate index (.edsi) next to the output", cxxopts::value<bool>()->default_value("false"))
+          ("index-stride", "Reference bases between checkpoints of the index", cxxopts::value<int>()->default_value(std::to_string(EdsIndex::default_stride)))
+          ("threads", "Number of threads for formatting the output and for BGZF compression and decompression", cxxopts::value<int>()->default_value("1"))
+          ;
+
+  auto result = options.parse(argc, argv);
+  if (!result.count("i") || !result.count("o") || (region_names.empty() && !result.count("bed")))
+  {
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  HtsThreadPool thread_pool(result["threads"].as<int>());
+  std::string input_file = result["i"].as<std::string>();
+  auto reader = IndexedEdsReader::open(input_file, thread_pool.get());
+  if (!reader)
+  {
+    std::cout << "Could not open given EDS file with its index: " << input_file << std::endl;
+    return 1;
+  }
+
+  std::vector<Region> regions;
+  try
+  {
+    // names like HLA-A*01:01 are whole contigs, not coordinates
+    for (const auto & name : region_names)
+    {
+      if (reader->get_index().find(name))
+        regions.push_back(Region{name, 1, std::numeric_limits<size_t>::max()});
+      else
+        regions.push_back(Region::parse(name));
+    }
+    if (result.count("bed"))
+    {
+      auto bed_regions = read_bed(result["bed"].as<std::string>());
+      regions.insert(regions.end(), bed_regions.begin(), bed_regions.end());
+    }
+  }
+  catch (const std::exception & e)
+  {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+
+  auto format = EDS::parse_format(result["f"].as<std::string>());
+  auto index = output_index(result, format);
+  auto output = open_output(result, result["o"].as<std::string>(), thread_pool.get());
+  for (const auto & region : regions)
+  {
+    EDS eds = slice_eds(*reader, region);
+    if (eds.size() == 0)
+      std::cout << "region " << region.to_string() << " is not covered by the EDS" << std::endl;
+    eds.save(*output, format, index.get(), result["threads"].as<int>());
+  }
+  if (!close_output(*output, result["o"].as<std::string>()))
+    return 1;
+  save_index(index.get(), result["o"].as<std::string>());
+  return 0;
 }
 
 int main(int argc, char * argv[])
 {
+  if (argc > 1 && std::string(argv[1]) == "convert")
+    return convert_exec(argc - 1, argv + 1);
+  if (argc > 1 && std::string(argv[1]) == "slice")
+    return slice_exec(argc - 1, argv + 1);
+
   cxxopts::Options options("vcf2eds", "Converts VCF files to elastic degenerate string.");
 
   std::vector<std::string> vcf_files;
 
   options.add_options()
           ("o,output", "File name of resulting EDS file", cxxopts::value<std::string>())
+          ("f,format", "Format of the resulting EDS (text, binary)", cxxopts::value<std::string>()->default_value("text"))
           ("r,reference", "File name of reference", cxxopts::value<std::string>())
           ("v,vcf", "Input VCF files", cxxopts::value<std::vector<std::string>>(vcf_files))
           ("m,merge", "Length of gaps that will be merged", cxxopts::value<int>())
+          ("merge-limit", "Maximum number of bytes joining two segments with -m may add to the output", cxxopts::value<int>()->default_value("64"))
+          ("b,backend", "VCF parsing backend (htslib, vcflib)", cxxopts::value<std::string>()->default_value("htslib"))
+          ("s,streaming", "Stream sorted VCF records into the output without keeping all variants in memory", cxxopts::value<bool>()->default_value("false"))
+          ("p,phased", "List only haplotypes present in phased sample genotypes, implies streaming", cxxopts::value<bool>()->default_value("false"))
+          ("z,bgzf", "Compress the output with BGZF, blocks are compressed on --threads threads", cxxopts::value<bool>()->default_value("false"))
+          ("x,index", "Write a coordinate index (.edsi) next to the output", cxxopts::value<bool>()->default_value("false"))
+          ("index-stride", "Reference bases between checkpoints of the index", cxxopts::value<int>()->default_value(std::to_string(EdsIndex::default_stride)))
+          ("threads", "Number of threads for formatting the output and for BGZF compression and decompression", cxxopts::value<int>()->default_value("1"))
+          ("c,contigs", "Convert every contig of the indexed VCF files separately", cxxopts::value<bool>()->default_value("false"))
+          ("j,jobs", "Number of contigs converted in parallel", cxxopts::value<int>()->default_value("1"))
+          ("split", "Write one EDS file per contig", cxxopts::value<bool>()->default_value("false"))
+          ("shards", "Number of regions of similar variant density each contig is split into", cxxopts::value<int>()->default_value("1"))
           ("t,test", "Test features and statistics - dev", cxxopts::value<bool>()->default_value("false"))
           ;
 
@@ -224,6 +722,11 @@ int main(int argc, char * argv[])
 
   if (result["t"].as<bool>())
     experiments(result, vcf_files);
+  else if (result["c"].as<bool>() && result["p"].as<bool>())
+    std::cout << "Phased merge is not supported together with -c" << std::endl;
+  else if (result["c"].as<bool>())
+    vcf2eds_contigs_exec(result, vcf_files);
   else
-    vcf2eds_exec(result, vcf_files);
+    return vcf2eds_exec(result, vcf_files);
+  return 0;
 }
\ No newline at end of file
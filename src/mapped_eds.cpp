@@ -0,0 +1,211 @@
+#include "mapped_eds.h"
+#include "eds_format.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  // position, number of alternatives
+  constexpr size_t segment_header = 12;
+
+  void malformed()
+  {
+    throw std::runtime_error("Malformed binary EDS segment");
+  }
+}
+
+MappedSegment::MappedSegment(const char * data, const char * end)
+  : data(data), end(end)
+{
+  if (end - data < static_cast<ptrdiff_t>(segment_header + 4) ||
+      static_cast<size_t>(end - data) - segment_header - 4 < read_le32(data + segment_header))
+    malformed();
+}
+
+size_t MappedSegment::start_position() const
+{
+  return read_le64(data);
+}
+
+size_t MappedSegment::end_position() const
+{
+  return start_position() + length() - 1;
+}
+
+size_t MappedSegment::length() const
+{
+  return read_le32(data + segment_header);
+}
+
+bool MappedSegment::is_degenerate() const
+{
+  return variant_count() > 0;
+}
+
+StringRef MappedSegment::reference() const
+{
+  return StringRef{data + segment_header + 4, length()};
+}
+
+size_t MappedSegment::variant_count() const
+{
+  return read_le32(data + 8);
+}
+
+StringRef MappedSegment::variant(size_t variant_idx) const
+{
+  const char * string = data + segment_header + 4 + length();
+  for (size_t i = 0; ; ++i)
+  {
+    if (end - string < 4 || static_cast<size_t>(end - string) - 4 < read_le32(string))
+      malformed();
+    if (i == variant_idx)
+      return StringRef{string + 4, read_le32(string)};
+    string += 4 + read_le32(string);
+  }
+}
+
+std::ostream & operator << (std::ostream & os, const MappedSegment & segment)
+{
+  if (segment.is_degenerate())
+  {
+    os << "{" << segment.reference();
+    for (size_t i = 0; i < segment.variant_count(); ++i)
+      os << "," << segment.variant(i);
+    os << "}";
+  }
+  else
+  {
+    os << segment.reference();
+  }
+
+  return os;
+}
+
+MappedEds::const_iterator::const_iterator(const MappedEds & eds, size_t idx)
+  : eds(eds), idx(idx)
+{ }
+
+MappedSegment MappedEds::const_iterator::operator * () const
+{
+  return eds.segment(idx);
+}
+
+MappedEds::const_iterator & MappedEds::const_iterator::operator ++ ()
+{
+  ++idx;
+  return *this;
+}
+
+bool MappedEds::const_iterator::operator != (const const_iterator & other) const
+{
+  return idx != other.idx;
+}
+
+std::unique_ptr<MappedEds> MappedEds::open(const std::string & filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  std::unique_ptr<MappedEds> eds(new MappedEds());
+  eds->mapping_length = info.st_size;
+  eds->mapping = mmap(nullptr, eds->mapping_length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (eds->mapping == MAP_FAILED)
+  {
+    eds->mapping = nullptr;
+    return nullptr;
+  }
+
+  // segments are usually picked here and there, do not read ahead the whole file
+  madvise(eds->mapping, eds->mapping_length, MADV_RANDOM);
+
+  eds->map_containers();
+  return eds;
+}
+
+MappedEds::~MappedEds()
+{
+  if (mapping)
+    munmap(mapping, mapping_length);
+}
+
+void MappedEds::map_containers()
+{
+  const char * data = static_cast<const char *>(mapping);
+  size_t remaining = mapping_length;
+  while (remaining > 0)
+  {
+    BinaryEdsHeader header;
+    size_t header_size = header.parse(data, remaining);
+    size_t table_size = 8 * (header.segment_count + 1);
+    if (header.segment_count > remaining / 8 || remaining - header_size < table_size ||
+        remaining - header_size - table_size < header.payload_size)
+      throw std::runtime_error("Truncated binary EDS");
+
+    containers.push_back(Container{header.contig, segment_total, header.segment_count,
+                                   data + header_size, data + header_size + table_size, header.payload_size});
+    segment_total += header.segment_count;
+
+    size_t container_size = header_size + table_size + header.payload_size;
+    data += container_size;
+    remaining -= container_size;
+  }
+}
+
+size_t MappedEds::size() const
+{
+  return segment_total;
+}
+
+MappedSegment MappedEds::segment(size_t idx) const
+{
+  auto container = std::upper_bound(containers.begin(), containers.end(), idx,
+                                    [](size_t i, const Container & c) { return i < c.first_segment; }) - 1;
+  size_t local = idx - container->first_segment;
+  size_t begin = read_le64(container->offsets + 8 * local);
+  size_t end = read_le64(container->offsets + 8 * (local + 1));
+  if (begin > end || end > container->payload_size)
+    malformed();
+
+  return MappedSegment(container->payload + begin, container->payload + end);
+}
+
+MappedEds::const_iterator MappedEds::begin() const
+{
+  return const_iterator(*this, 0);
+}
+
+MappedEds::const_iterator MappedEds::end() const
+{
+  return const_iterator(*this, size());
+}
+
+size_t MappedEds::contig_count() const
+{
+  return containers.size();
+}
+
+const std::string & MappedEds::contig(size_t contig_idx) const
+{
+  return containers[contig_idx].contig;
+}
+
+size_t MappedEds::first_segment(size_t contig_idx) const
+{
+  return contig_idx < containers.size() ? containers[contig_idx].first_segment : segment_total;
+}
@@ -0,0 +1,111 @@
+#ifndef VCF2EDS_MAPPED_EDS_H
+#define VCF2EDS_MAPPED_EDS_H
+
+#include "eds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Segment of a mapped binary EDS, decoded from the mapping on access.
+ */
+class MappedSegment
+{
+public:
+  MappedSegment(const char * data, const char * end);
+
+  size_t start_position() const;
+  size_t end_position() const;
+  size_t length() const;
+  bool is_degenerate() const;
+
+  StringRef reference() const;
+  size_t variant_count() const;
+
+  /**
+   * Walks the length prefixes of the preceding alternatives, linear in variant_idx.
+   */
+  StringRef variant(size_t variant_idx) const;
+
+  friend std::ostream & operator << (std::ostream & os, const MappedSegment & segment);
+private:
+  const char * data;
+  const char * end;
+};
+
+/**
+ * Read-only binary EDS mapped into memory. Opening reads only the container headers,
+ * segments are found through the offset tables and decoded when accessed, so neither
+ * random access nor iteration allocates. Segments of all containers in the file are
+ * numbered consecutively.
+ *
+ * Only the binary format is supported. A text EDS has no offset table, its segment
+ * boundaries are known only after parsing up to them, and a .edsi keeps just every
+ * stride-th of them - mapping it would mean parsing, which IndexedEdsReader already
+ * does for random access into text files.
+ */
+class MappedEds
+{
+public:
+  class const_iterator
+  {
+  public:
+    const_iterator(const MappedEds & eds, size_t idx);
+
+    MappedSegment operator * () const;
+    const_iterator & operator ++ ();
+    bool operator != (const const_iterator & other) const;
+  private:
+    const MappedEds & eds;
+    size_t idx;
+  };
+
+  /**
+   * Maps a binary EDS file, returns nullptr when it cannot be opened.
+   * Throws std::runtime_error when the file is not a valid binary EDS, text EDS included.
+   */
+  static std::unique_ptr<MappedEds> open(const std::string & filename);
+
+  ~MappedEds();
+
+  MappedEds(const MappedEds &) = delete;
+  MappedEds & operator = (const MappedEds &) = delete;
+
+  size_t size() const;
+  MappedSegment segment(size_t idx) const;
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  size_t contig_count() const;
+  const std::string & contig(size_t contig_idx) const;
+
+  /**
+   * Segments of contig contig_idx are [first_segment(contig_idx), first_segment(contig_idx + 1)).
+   */
+  size_t first_segment(size_t contig_idx) const;
+private:
+  struct Container
+  {
+    std::string contig;
+    size_t first_segment;
+    size_t segment_count;
+    const char * offsets;
+    const char * payload;
+    size_t payload_size;
+  };
+
+  MappedEds() = default;
+
+  void map_containers();
+
+  void * mapping = nullptr;
+  size_t mapping_length = 0;
+  std::vector<Container> containers;
+  size_t segment_total = 0;
+};
+
+#endif //VCF2EDS_MAPPED_EDS_H
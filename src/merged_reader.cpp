@@ -0,0 +1,220 @@
+#include "merged_reader.h"
+
+#include <algorithm>
+
+PrefetchReader::PrefetchReader(std::unique_ptr<VcfReader> && reader, size_t batch_size)
+  : reader(std::move(reader)), batch_size(batch_size), batches(4)
+{
+  if (this->reader->is_open())
+    thread = std::thread(&PrefetchReader::read_batches, this);
+  else
+    batches.close();
+}
+
+PrefetchReader::~PrefetchReader()
+{
+  batches.close();
+  if (thread.joinable())
+    thread.join();
+}
+
+bool PrefetchReader::is_open() const
+{
+  return reader->is_open();
+}
+
+void PrefetchReader::read_batches()
+{
+  try
+  {
+    bool more = true;
+    while (more)
+    {
+      std::vector<VcfRecord> records(batch_size);
+      size_t count = 0;
+      while (count < batch_size && (more = reader->next(records[count])))
+        count++;
+
+      records.resize(count);
+      if (count > 0 && !batches.push(std::move(records)))
+        return;
+    }
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+  }
+
+  batches.close();
+}
+
+bool PrefetchReader::next(VcfRecord & record)
+{
+  while (batch_pos == batch.size())
+  {
+    batch_pos = 0;
+    if (!batches.pop(batch))
+    {
+      batch.clear();
+      if (error)
+        std::rethrow_exception(error);
+      return false;
+    }
+  }
+
+  record = std::move(batch[batch_pos++]);
+  return true;
+}
+
+bool MergedVcfReader::HeadGreater::operator () (const Head * lhs, const Head * rhs) const
+{
+  if (lhs->record.position != rhs->record.position)
+    return lhs->record.position > rhs->record.position;
+
+  return lhs->input > rhs->input;
+}
+
+MergedVcfReader::MergedVcfReader(std::vector<std::unique_ptr<VcfReader>> && readers)
+  : readers(std::move(readers)), heads(this->readers.size())
+{
+  size_t haplotype_count = 0;
+  for (size_t input = 0; input < this->readers.size(); ++input)
+  {
+    heads[input].input = input;
+    if (this->readers[input]->is_open() && this->readers[input]->next(heads[input].record))
+      waiting.push_back(input);
+
+    haplotype_offsets.push_back(haplotype_count);
+    haplotype_count += heads[input].record.haplotypes.size();
+  }
+  haplotype_offsets.push_back(haplotype_count);
+  if (haplotype_count == 0)
+    haplotype_offsets.clear();
+}
+
+bool MergedVcfReader::is_open() const
+{
+  return std::all_of(readers.begin(), readers.end(), [](const auto & reader) { return reader->is_open(); });
+}
+
+size_t MergedVcfReader::duplicates() const
+{
+  return duplicate_count;
+}
+
+bool MergedVcfReader::start_next_contig()
+{
+  if (waiting.empty())
+    return false;
+
+  if (!contig.empty())
+    finished_contigs.insert(contig);
+
+  // the next contig is the one the first waiting input continues with
+  contig = heads[*std::min_element(waiting.begin(), waiting.end())].record.chromosome;
+  if (finished_contigs.count(contig) > 0)
+    throw UnsortedInputError("Contig " + contig + " is not contiguous in the inputs");
+
+  auto moved = std::stable_partition(waiting.begin(), waiting.end(),
+                                     [this](size_t input) { return heads[input].record.chromosome != contig; });
+  for (auto iter = moved; iter != waiting.end(); ++iter)
+  {
+    heap.push_back(&heads[*iter]);
+    std::push_heap(heap.begin(), heap.end(), HeadGreater());
+  }
+  waiting.erase(moved, waiting.end());
+  return true;
+}
+
+void MergedVcfReader::advance(size_t input, size_t previous)
+{
+  Head & head = heads[input];
+  if (!readers[input]->next(head.record))
+    return;
+
+  if (head.record.chromosome != contig)
+  {
+    waiting.push_back(input);
+    return;
+  }
+
+  if (head.record.position < previous)
+    throw UnsortedInputError("VCF input " + std::to_string(input + 1) + " is not sorted: position "
+                             + std::to_string(head.record.position) + " follows " + std::to_string(previous));
+
+  heap.push_back(&head);
+  std::push_heap(heap.begin(), heap.end(), HeadGreater());
+}
+
+void MergedVcfReader::place_haplotypes(const VcfRecord & source, size_t input, VcfRecord & target) const
+{
+  if (haplotype_offsets.empty())
+    return;
+
+  size_t offset = haplotype_offsets[input];
+  size_t count = std::min(source.haplotypes.size(), haplotype_offsets[input + 1] - offset);
+  target.haplotypes.resize(haplotype_offsets.back(), -1);
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (target.haplotypes[offset + i] < 0)
+      target.haplotypes[offset + i] = source.haplotypes[i];
+  }
+  target.phased = target.phased && source.phased;
+}
+
+bool MergedVcfReader::read_position()
+{
+  if (heap.empty() && !start_next_contig())
+    return false;
+
+  // records of one position are consecutive in the heap order, including the ones
+  // the inputs advance to while they are read
+  size_t position = heap.front()->record.position;
+  while (!heap.empty() && heap.front()->record.position == position)
+  {
+    std::pop_heap(heap.begin(), heap.end(), HeadGreater());
+    Head * head = heap.back();
+    heap.pop_back();
+
+    // collapse records repeated in several callsets
+    auto & source = head->record;
+    auto same = std::find_if(pending.begin(), pending.end(), [&source](const VcfRecord & record)
+    {
+      return record.ref == source.ref && record.alt == source.alt;
+    });
+
+    if (same != pending.end())
+    {
+      duplicate_count++;
+      place_haplotypes(source, head->input, *same);
+    }
+    else if (haplotype_offsets.empty())
+    {
+      pending.push_back(std::move(source));
+    }
+    else
+    {
+      VcfRecord record;
+      record.chromosome = std::move(source.chromosome);
+      record.position = source.position;
+      record.ref = std::move(source.ref);
+      record.alt = std::move(source.alt);
+      place_haplotypes(source, head->input, record);
+      pending.push_back(std::move(record));
+    }
+
+    advance(head->input, position);
+  }
+
+  return true;
+}
+
+bool MergedVcfReader::next(VcfRecord & record)
+{
+  if (pending.empty() && !read_position())
+    return false;
+
+  record = std::move(pending.front());
+  pending.pop_front();
+  return true;
+}
@@ -0,0 +1,95 @@
+#ifndef VCF2EDS_MERGED_READER_H
+#define VCF2EDS_MERGED_READER_H
+
+#include "vcf_reader.h"
+#include "utils/spsc_queue.h"
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Reads records of another reader on its own thread, handing them over in batches.
+ */
+class PrefetchReader : public VcfReader
+{
+public:
+  explicit PrefetchReader(std::unique_ptr<VcfReader> && reader, size_t batch_size = 4096);
+  ~PrefetchReader() override;
+
+  bool is_open() const override;
+  bool next(VcfRecord & record) override;
+private:
+  void read_batches();
+
+  std::unique_ptr<VcfReader> reader;
+  size_t batch_size;
+  SpscQueue<std::vector<VcfRecord>> batches;
+  std::vector<VcfRecord> batch;
+  size_t batch_pos = 0;
+  std::exception_ptr error;
+  std::thread thread;
+};
+
+/**
+ * K-way merge of coordinate-sorted readers. Yields records contig by contig in the
+ * order the contigs appear in the inputs and by position within a contig; records
+ * at the same position come in input order. Records with the same position, REF and
+ * ALT are collapsed into the first of them.
+ *
+ * With genotypes, the haplotypes of every input take their own range of the merged
+ * haplotype list, sized by the first record of the input, and are missing (-1) in
+ * records the input does not have. A collapsed record carries the haplotypes of all
+ * the inputs it was found in.
+ */
+class MergedVcfReader : public VcfReader
+{
+public:
+  explicit MergedVcfReader(std::vector<std::unique_ptr<VcfReader>> && readers);
+
+  bool is_open() const override;
+  bool next(VcfRecord & record) override;
+
+  size_t duplicates() const;
+private:
+  struct Head
+  {
+    VcfRecord record;
+    size_t input;
+  };
+
+  struct HeadGreater
+  {
+    bool operator () (const Head * lhs, const Head * rhs) const;
+  };
+
+  void advance(size_t input, size_t previous_position);
+  bool start_next_contig();
+
+  /**
+   * Reads the records of all inputs at the next position into pending, collapsing
+   * repeated ones. Returns false when the inputs are exhausted.
+   */
+  bool read_position();
+  void place_haplotypes(const VcfRecord & source, size_t input, VcfRecord & target) const;
+
+  std::vector<std::unique_ptr<VcfReader>> readers;
+  std::vector<Head> heads;
+  std::vector<Head *> heap;
+  std::vector<size_t> waiting;
+
+  std::string contig;
+  std::set<std::string> finished_contigs;
+
+  // haplotypes of input i are placed from haplotype_offsets[i], empty without genotypes
+  std::vector<size_t> haplotype_offsets;
+  std::deque<VcfRecord> pending;
+  size_t duplicate_count = 0;
+};
+
+#endif //VCF2EDS_MERGED_READER_H
@@ -0,0 +1,332 @@
+#include "packed_sequence.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VCF2EDS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  constexpr size_t word_bases = 32;
+
+  // (base >> 1) & 3 maps A, C, T, G (either case) to 0, 1, 2, 3
+  const char decode_table[] = "ACTG";
+
+  inline bool is_acgt(char base)
+  {
+    return base == 'A' || base == 'C' || base == 'G' || base == 'T';
+  }
+
+  inline uint64_t encode_base(char base)
+  {
+    return (static_cast<unsigned char>(base) >> 1) & 3;
+  }
+
+  /**
+   * Encodes 32 bases into one word, returns false when the block is not all
+   * uppercase ACGT, such blocks are encoded base by base.
+   */
+  using EncodeKernel = bool (*)(const char * data, uint64_t & word);
+
+  /**
+   * Decodes one full word into 32 bases.
+   */
+  using DecodeKernel = void (*)(uint64_t word, char * output);
+
+  bool encode_scalar(const char * data, uint64_t & word)
+  {
+    uint64_t result = 0;
+    for (size_t i = 0; i < word_bases; ++i)
+    {
+      if (!is_acgt(data[i]))
+        return false;
+      result |= encode_base(data[i]) << (2 * i);
+    }
+
+    word = result;
+    return true;
+  }
+
+  void decode_scalar(uint64_t word, char * output)
+  {
+    for (size_t i = 0; i < word_bases; ++i)
+      output[i] = decode_table[(word >> (2 * i)) & 3];
+  }
+
+#ifdef VCF2EDS_X86_KERNELS
+  __attribute__((target("sse4.1")))
+  bool encode_sse_half(const char * data, uint32_t & half)
+  {
+    __m128i bases = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i valid = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bases, _mm_set1_epi8('A')), _mm_cmpeq_epi8(bases, _mm_set1_epi8('C'))),
+            _mm_or_si128(_mm_cmpeq_epi8(bases, _mm_set1_epi8('G')), _mm_cmpeq_epi8(bases, _mm_set1_epi8('T'))));
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+      return false;
+
+    __m128i codes = _mm_and_si128(_mm_srli_epi16(bases, 1), _mm_set1_epi8(3));
+    // combine neighbouring codes: pairs into 4 bits, quads into 8 bits
+    __m128i pairs = _mm_maddubs_epi16(codes, _mm_set1_epi16(0x0401));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00100001));
+    __m128i packed = _mm_shuffle_epi8(quads, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+                                                           -1, -1, -1, -1, -1, -1, -1, -1));
+    half = static_cast<uint32_t>(_mm_cvtsi128_si32(packed));
+    return true;
+  }
+
+  __attribute__((target("sse4.1")))
+  bool encode_sse(const char * data, uint64_t & word)
+  {
+    uint32_t low, high;
+    if (!encode_sse_half(data, low) || !encode_sse_half(data + 16, high))
+      return false;
+
+    word = low | (static_cast<uint64_t>(high) << 32);
+    return true;
+  }
+
+  __attribute__((target("sse4.1")))
+  void decode_sse_half(uint32_t half, char * output)
+  {
+    // byte i gets packed byte i / 4, then the codes are shifted down by 2 * (i % 4)
+    __m128i spread = _mm_shuffle_epi8(_mm_cvtsi32_si128(static_cast<int>(half)),
+                                      _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3));
+    __m128i codes = _mm_blendv_epi8(spread, _mm_srli_epi16(spread, 2),
+                                    _mm_setr_epi8(0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0));
+    codes = _mm_blendv_epi8(codes, _mm_srli_epi16(spread, 4),
+                            _mm_setr_epi8(0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0));
+    codes = _mm_blendv_epi8(codes, _mm_srli_epi16(spread, 6),
+                            _mm_setr_epi8(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1));
+    codes = _mm_and_si128(codes, _mm_set1_epi8(3));
+
+    __m128i table = _mm_setr_epi8('A', 'C', 'T', 'G', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output), _mm_shuffle_epi8(table, codes));
+  }
+
+  __attribute__((target("sse4.1")))
+  void decode_sse(uint64_t word, char * output)
+  {
+    decode_sse_half(static_cast<uint32_t>(word), output);
+    decode_sse_half(static_cast<uint32_t>(word >> 32), output + 16);
+  }
+
+  __attribute__((target("avx2")))
+  bool encode_avx2(const char * data, uint64_t & word)
+  {
+    __m256i bases = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    __m256i valid = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bases, _mm256_set1_epi8('A')),
+                            _mm256_cmpeq_epi8(bases, _mm256_set1_epi8('C'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bases, _mm256_set1_epi8('G')),
+                            _mm256_cmpeq_epi8(bases, _mm256_set1_epi8('T'))));
+    if (static_cast<uint32_t>(_mm256_movemask_epi8(valid)) != 0xFFFFFFFFu)
+      return false;
+
+    __m256i codes = _mm256_and_si256(_mm256_srli_epi16(bases, 1), _mm256_set1_epi8(3));
+    __m256i pairs = _mm256_maddubs_epi16(codes, _mm256_set1_epi16(0x0401));
+    __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00100001));
+    // shuffles stay within 128-bit lanes, each lane packs 16 bases into its low 4 bytes
+    __m256i packed = _mm256_shuffle_epi8(quads, _mm256_setr_epi8(
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+
+    word = static_cast<uint32_t>(_mm256_extract_epi32(packed, 0))
+           | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_extract_epi32(packed, 4))) << 32);
+    return true;
+  }
+
+  __attribute__((target("avx2")))
+  void decode_avx2(uint64_t word, char * output)
+  {
+    __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi64x(static_cast<long long>(word)), _mm256_setr_epi8(
+            0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+            4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7));
+    __m256i shift1 = _mm256_set1_epi32(0x0000FF00);
+    __m256i shift2 = _mm256_set1_epi32(0x00FF0000);
+    __m256i shift3 = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    __m256i codes = _mm256_blendv_epi8(spread, _mm256_srli_epi16(spread, 2), shift1);
+    codes = _mm256_blendv_epi8(codes, _mm256_srli_epi16(spread, 4), shift2);
+    codes = _mm256_blendv_epi8(codes, _mm256_srli_epi16(spread, 6), shift3);
+    codes = _mm256_and_si256(codes, _mm256_set1_epi8(3));
+
+    __m256i table = _mm256_setr_epi8('A', 'C', 'T', 'G', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                     'A', 'C', 'T', 'G', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), _mm256_shuffle_epi8(table, codes));
+  }
+#endif
+
+  struct Kernel
+  {
+    const char * name;
+    EncodeKernel encode;
+    DecodeKernel decode;
+  };
+
+  Kernel select_kernel()
+  {
+    // VCF2EDS_KERNEL names the only kernel allowed, so tests can run each of them
+    const char * forced = std::getenv("VCF2EDS_KERNEL");
+    auto allowed = [forced](const char * name) { return !forced || std::strcmp(forced, name) == 0; };
+#ifdef VCF2EDS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && allowed("avx2"))
+      return Kernel{"avx2", encode_avx2, decode_avx2};
+    if (__builtin_cpu_supports("sse4.1") && allowed("sse4.1"))
+      return Kernel{"sse4.1", encode_sse, decode_sse};
+#endif
+    (void) allowed;
+    return Kernel{"scalar", encode_scalar, decode_scalar};
+  }
+
+  const Kernel & active_kernel()
+  {
+    static const Kernel selected = select_kernel();
+    return selected;
+  }
+}
+
+PackedSequence::PackedSequence(const char * data, size_t length)
+{
+  append(data, length);
+}
+
+PackedSequence::PackedSequence(const std::string & sequence)
+  : PackedSequence(sequence.data(), sequence.length())
+{ }
+
+void PackedSequence::append(const char * data, size_t length)
+{
+  words.reserve((bases + length + word_bases - 1) / word_bases);
+  const auto & encode = active_kernel().encode;
+
+  size_t i = 0;
+  while (i < length)
+  {
+    if (bases % word_bases == 0 && length - i >= word_bases)
+    {
+      uint64_t word;
+      if (encode(data + i, word))
+      {
+        words.push_back(word);
+        bases += word_bases;
+        i += word_bases;
+        continue;
+      }
+    }
+
+    char base = data[i++];
+    if (base >= 'a' && base <= 'z')
+    {
+      append_masked(bases);
+      base -= 'a' - 'A';
+    }
+
+    uint64_t code = 0;
+    if (is_acgt(base))
+      code = encode_base(base);
+    else
+      append_exception(bases, base);
+
+    if (bases % word_bases == 0)
+      words.push_back(0);
+    words.back() |= code << (2 * (bases % word_bases));
+    ++bases;
+  }
+}
+
+void PackedSequence::append_exception(size_t position, char base)
+{
+  if (!exceptions.empty() && exceptions.back().base == base
+      && exceptions.back().begin + exceptions.back().length == position)
+    exceptions.back().length++;
+  else
+    exceptions.push_back(Run{position, 1, base});
+}
+
+void PackedSequence::append_masked(size_t position)
+{
+  if (!masked.empty() && masked.back().end == position)
+    masked.back().end++;
+  else
+    masked.push_back(Interval{position, position + 1});
+}
+
+size_t PackedSequence::length() const
+{
+  return bases;
+}
+
+std::string PackedSequence::decode(size_t offset, size_t count) const
+{
+  if (offset >= bases)
+    return std::string();
+  count = std::min(count, bases - offset);
+
+  std::string result(count, '\0');
+  decode(offset, count, &result[0]);
+  return result;
+}
+
+void PackedSequence::decode(size_t offset, size_t count, char * output) const
+{
+  if (offset >= bases)
+    return;
+  count = std::min(count, bases - offset);
+
+  const auto & decode_word = active_kernel().decode;
+  size_t end = offset + count;
+  size_t position = offset;
+  while (position < end)
+  {
+    if (position % word_bases == 0 && end - position >= word_bases)
+    {
+      decode_word(words[position / word_bases], output + (position - offset));
+      position += word_bases;
+    }
+    else
+    {
+      output[position - offset] = decode_table[(words[position / word_bases] >> (2 * (position % word_bases))) & 3];
+      ++position;
+    }
+  }
+
+  // runs are sorted and disjoint, so their ends are sorted as well
+  auto run = std::partition_point(exceptions.begin(), exceptions.end(),
+                                  [offset](const Run & run) { return run.begin + run.length <= offset; });
+  for (; run != exceptions.end() && run->begin < end; ++run)
+  {
+    size_t from = std::max(run->begin, offset);
+    size_t to = std::min(run->begin + run->length, end);
+    std::fill(output + (from - offset), output + (to - offset), run->base);
+  }
+
+  auto interval = std::partition_point(masked.begin(), masked.end(),
+                                       [offset](const Interval & interval) { return interval.end <= offset; });
+  for (; interval != masked.end() && interval->begin < end; ++interval)
+  {
+    size_t from = std::max(interval->begin, offset);
+    size_t to = std::min(interval->end, end);
+    for (size_t i = from; i < to; ++i)
+    {
+      char & base = output[i - offset];
+      if (base >= 'A' && base <= 'Z')
+        base += 'a' - 'A';
+    }
+  }
+}
+
+size_t PackedSequence::memory_usage() const
+{
+  return words.capacity() * sizeof(uint64_t)
+         + exceptions.capacity() * sizeof(Run)
+         + masked.capacity() * sizeof(Interval);
+}
+
+const char * PackedSequence::kernel()
+{
+  return active_kernel().name;
+}
@@ -0,0 +1,69 @@
+#ifndef VCF2EDS_PACKED_SEQUENCE_H
+#define VCF2EDS_PACKED_SEQUENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Nucleotide sequence stored with 2 bits per base, 32 bases per word. Bases other
+ * than ACGT (N runs, IUPAC codes) are kept in a list of runs and lowercase
+ * (soft-masked) stretches in a list of intervals, so decoding gives back exactly
+ * the original text. Encoding and decoding use AVX2 or SSE4.1 when the CPU has them.
+ */
+class PackedSequence
+{
+public:
+  PackedSequence() = default;
+  PackedSequence(const char * data, size_t length);
+  explicit PackedSequence(const std::string & sequence);
+
+  /**
+   * Appends bases to the end of the sequence.
+   */
+  void append(const char * data, size_t length);
+
+  size_t length() const;
+
+  /**
+   * Decodes count bases starting at offset, clipped to the end of the sequence.
+   */
+  std::string decode(size_t offset, size_t count) const;
+  void decode(size_t offset, size_t count, char * output) const;
+
+  /**
+   * Bytes held by the sequence, for statistics.
+   */
+  size_t memory_usage() const;
+
+  /**
+   * Name of the encoding kernel picked for this CPU - "avx2", "sse4.1" or "scalar".
+   * Setting VCF2EDS_KERNEL to a name restricts the choice to that kernel, any other
+   * value to the scalar one.
+   */
+  static const char * kernel();
+private:
+  struct Run
+  {
+    size_t begin;
+    size_t length;
+    char base;
+  };
+
+  struct Interval
+  {
+    size_t begin;
+    size_t end;
+  };
+
+  void append_exception(size_t position, char base);
+  void append_masked(size_t position);
+
+  std::vector<uint64_t> words;
+  size_t bases = 0;
+  std::vector<Run> exceptions;
+  std::vector<Interval> masked;
+};
+
+#endif //VCF2EDS_PACKED_SEQUENCE_H
@@ -0,0 +1,364 @@
+#include "reference.h"
+#include "packed_sequence.h"
+#include "utils/kseq.h"
+
+#include <htslib/bgzf.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+KSEQ_INIT(BGZF *, bgzf_read)
+
+namespace
+{
+  constexpr size_t write_chunk = 64 * 1024;
+
+  /**
+   * Record held in memory with 2 bits per base.
+   */
+  class InMemorySequence : public ContigSequence
+  {
+  public:
+    InMemorySequence(const char * data, size_t length)
+      : sequence(data, length)
+    { }
+
+    size_t length() const override
+    {
+      return sequence.length();
+    }
+
+    std::string fetch(size_t offset, size_t count) const override
+    {
+      return sequence.decode(offset, count);
+    }
+
+    void for_each_piece(size_t offset, size_t count, const PieceConsumer & consumer) const override
+    {
+      if (offset >= sequence.length())
+        return;
+      count = std::min(count, sequence.length() - offset);
+
+      char buffer[write_chunk];
+      while (count > 0)
+      {
+        size_t chunk = std::min(count, write_chunk);
+        sequence.decode(offset, chunk, buffer);
+        consumer(buffer, chunk);
+        offset += chunk;
+        count -= chunk;
+      }
+    }
+  private:
+    PackedSequence sequence;
+  };
+
+  /**
+   * Record of an uncompressed FASTA mapped into memory, lines are skipped using
+   * the layout stored in the .fai.
+   */
+  class MappedSequence : public ContigSequence
+  {
+  public:
+    MappedSequence(const char * data, size_t bases, size_t line_bases, size_t line_width)
+      : data(data), bases(bases), line_bases(line_bases), line_width(line_width)
+    { }
+
+    size_t length() const override
+    {
+      return bases;
+    }
+
+    std::string fetch(size_t offset, size_t count) const override
+    {
+      if (offset >= bases)
+        return std::string();
+      count = std::min(count, bases - offset);
+
+      std::string result;
+      result.reserve(count);
+      for_each_line(offset, count, [&result](const char * line, size_t length) { result.append(line, length); });
+      return result;
+    }
+
+    void for_each_piece(size_t offset, size_t count, const PieceConsumer & consumer) const override
+    {
+      if (offset >= bases)
+        return;
+      count = std::min(count, bases - offset);
+
+      // straight from the mapping, line by line
+      for_each_line(offset, count, consumer);
+    }
+  private:
+    template<class Callback>
+    void for_each_line(size_t offset, size_t count, const Callback & callback) const
+    {
+      while (count > 0)
+      {
+        size_t column = offset % line_bases;
+        size_t chunk = std::min(count, line_bases - column);
+        callback(data + (offset / line_bases) * line_width + column, chunk);
+        offset += chunk;
+        count -= chunk;
+      }
+    }
+
+  private:
+    const char * data;
+    size_t bases;
+    size_t line_bases;
+    size_t line_width;
+  };
+
+  /**
+   * Record of a bgzipped FASTA, faidx keeps one BGZF stream so fetches are serialized.
+   */
+  class FaidxSequence : public ContigSequence
+  {
+  public:
+    FaidxSequence(faidx_t * fai, std::mutex & fai_mutex, const std::string & name, size_t bases)
+      : fai(fai), fai_mutex(fai_mutex), name(name), bases(bases)
+    { }
+
+    size_t length() const override
+    {
+      return bases;
+    }
+
+    std::string fetch(size_t offset, size_t count) const override
+    {
+      if (offset >= bases || count == 0)
+        return std::string();
+      count = std::min(count, bases - offset);
+
+      int fetched = 0;
+      char * sequence;
+      {
+        std::lock_guard<std::mutex> lock(fai_mutex);
+        sequence = faidx_fetch_seq(fai, name.c_str(), offset, offset + count - 1, &fetched);
+      }
+      if (!sequence)
+        throw std::runtime_error("Could not fetch " + name + " from the reference");
+
+      std::string result(sequence, std::max(fetched, 0));
+      free(sequence);
+      return result;
+    }
+  private:
+    faidx_t * fai;
+    std::mutex & fai_mutex;
+    std::string name;
+    size_t bases;
+  };
+
+  bool is_compressed(const std::string & filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[2] = {0, 0};
+    file.read(magic, 2);
+    return file && magic[0] == '\x1f' && magic[1] == '\x8b';
+  }
+
+  bool file_exists(const std::string & filename)
+  {
+    struct stat info;
+    return stat(filename.c_str(), &info) == 0;
+  }
+}
+
+void ContigSequence::for_each_piece(size_t offset, size_t count, const PieceConsumer & consumer) const
+{
+  size_t end = std::min(offset + count, length());
+  for (; offset < end; offset += write_chunk)
+  {
+    std::string piece = fetch(offset, std::min(write_chunk, end - offset));
+    consumer(piece.data(), piece.length());
+  }
+}
+
+void ContigSequence::write(std::ostream & os, size_t offset, size_t count) const
+{
+  for_each_piece(offset, count, [&os](const char * data, size_t length) { os.write(data, length); });
+}
+
+std::unique_ptr<Reference> Reference::open(const std::string & filename, hts_tpool * pool)
+{
+  if (file_exists(filename + ".fai"))
+  {
+    auto indexed = std::make_unique<IndexedReference>();
+    if (indexed->load(filename))
+      return indexed;
+  }
+
+  auto in_memory = std::make_unique<InMemoryReference>();
+  if (in_memory->load(filename, pool))
+    return in_memory;
+
+  return nullptr;
+}
+
+size_t Reference::size() const
+{
+  return sequences.size();
+}
+
+const std::string & Reference::name(size_t idx) const
+{
+  return names[idx];
+}
+
+const ContigSequence & Reference::sequence(size_t idx) const
+{
+  return *sequences[idx];
+}
+
+const ContigSequence * Reference::find(const std::string & contig) const
+{
+  auto iter = name_idx.find(contig);
+  if (iter == name_idx.end())
+  {
+    std::string alias = contig.compare(0, 3, "chr") == 0 ? contig.substr(3) : "chr" + contig;
+    iter = name_idx.find(alias);
+  }
+
+  return iter == name_idx.end() ? nullptr : sequences[iter->second].get();
+}
+
+const ContigSequence * Reference::resolve(const std::string & contig) const
+{
+  const ContigSequence * sequence = find(contig);
+  if (!sequence && sequences.size() == 1)
+    sequence = sequences[0].get();
+
+  return sequence;
+}
+
+void Reference::add_record(const std::string & name, std::unique_ptr<ContigSequence> && sequence)
+{
+  name_idx.insert(std::make_pair(name, names.size()));
+  names.push_back(name);
+  sequences.push_back(std::move(sequence));
+}
+
+bool InMemoryReference::load(const std::string & filename, hts_tpool * pool)
+{
+  // BGZF also reads plain gzip and uncompressed files
+  BGZF * file_ptr = bgzf_open(filename.c_str(), "r");
+  if (!file_ptr)
+    return false;
+  if (pool)
+    bgzf_thread_pool(file_ptr, pool, 0);
+
+  kseq_t * sequence = kseq_init(file_ptr);
+  while (kseq_read(sequence) >= 0)
+  {
+    add_record(std::string(sequence->name.s, sequence->name.l),
+               std::make_unique<InMemorySequence>(sequence->seq.s, sequence->seq.l));
+  }
+
+  kseq_destroy(sequence);
+  bgzf_close(file_ptr);
+  return true;
+}
+
+IndexedReference::~IndexedReference()
+{
+  if (fai)
+    fai_destroy(fai);
+  if (mapping)
+    munmap(mapping, mapping_length);
+}
+
+bool IndexedReference::load(const std::string & filename)
+{
+  if (is_compressed(filename))
+    return load_faidx(filename);
+
+  return load_mapped(filename);
+}
+
+bool IndexedReference::load_mapped(const std::string & filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  mapping_length = info.st_size;
+  mapping = mmap(nullptr, mapping_length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    mapping = nullptr;
+    return false;
+  }
+
+  // spans are fetched in increasing order
+  madvise(mapping, mapping_length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(mapping, mapping_length, MADV_HUGEPAGE);
+#endif
+
+  // .fai columns: name, length, offset, bases per line, bytes per line
+  std::ifstream index(filename + ".fai");
+  std::string line;
+  while (std::getline(index, line))
+  {
+    std::istringstream columns(line);
+    std::string name;
+    size_t bases, offset, line_bases, line_width;
+    if (!std::getline(columns, name, '\t') || !(columns >> bases >> offset >> line_bases >> line_width))
+      return false;
+    if (offset > mapping_length || line_bases == 0 || line_width < line_bases)
+      return false;
+
+    // a stale .fai or an edited FASTA must not send reads past the mapping
+    if (bases > 0)
+    {
+      size_t last_line = (bases - 1) / line_bases;
+      if (last_line > (mapping_length - offset) / line_width)
+        return false;
+      size_t last = offset + last_line * line_width + (bases - 1) % line_bases;
+      if (last >= mapping_length)
+        return false;
+    }
+
+    add_record(name, std::make_unique<MappedSequence>(
+            static_cast<const char *>(mapping) + offset, bases, line_bases, line_width
+    ));
+  }
+
+  return size() > 0;
+}
+
+bool IndexedReference::load_faidx(const std::string & filename)
+{
+  // bgzipped references need the .gzi next to the .fai, fai_load picks both up
+  fai = fai_load(filename.c_str());
+  if (!fai)
+    return false;
+
+  for (int i = 0; i < faidx_nseq(fai); ++i)
+  {
+    const char * name = faidx_iseq(fai, i);
+    add_record(name, std::make_unique<FaidxSequence>(fai, fai_mutex, name, faidx_seq_len(fai, name)));
+  }
+
+  return size() > 0;
+}
@@ -0,0 +1,122 @@
+#ifndef VCF2EDS_REFERENCE_H
+#define VCF2EDS_REFERENCE_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <htslib/faidx.h>
+#include <htslib/thread_pool.h>
+
+/**
+ * One reference record, bases are addressed from 0.
+ */
+class ContigSequence
+{
+public:
+  virtual ~ContigSequence() = default;
+
+  virtual size_t length() const = 0;
+
+  /**
+   * Returns count bases starting at offset, clipped to the end of the record.
+   */
+  virtual std::string fetch(size_t offset, size_t count) const = 0;
+
+  using PieceConsumer = std::function<void (const char * data, size_t length)>;
+
+  /**
+   * Passes count bases starting at offset to consumer in consecutive pieces, clipped
+   * to the end of the record. A piece is valid only during the call, the span is
+   * never held in memory as a whole.
+   */
+  virtual void for_each_piece(size_t offset, size_t count, const PieceConsumer & consumer) const;
+
+  /**
+   * Writes count bases starting at offset to the stream, clipped to the end of the
+   * record.
+   */
+  void write(std::ostream & os, size_t offset, size_t count) const;
+};
+
+/**
+ * Reference genome - a set of named records.
+ */
+class Reference
+{
+public:
+  virtual ~Reference() = default;
+
+  /**
+   * Opens an indexed reference when a .fai exists next to the file, otherwise loads
+   * all records into memory. Returns nullptr when the file cannot be opened.
+   */
+  static std::unique_ptr<Reference> open(const std::string & filename, hts_tpool * pool = nullptr);
+
+  size_t size() const;
+  const std::string & name(size_t idx) const;
+  const ContigSequence & sequence(size_t idx) const;
+
+  /**
+   * Looks up a record by VCF contig name, "chr22" and "22" are treated as the same contig.
+   * Returns nullptr when there is no such record.
+   */
+  const ContigSequence * find(const std::string & contig) const;
+
+  /**
+   * Like find, but a reference with a single record matches any contig, so that
+   * single chromosome files with unusual record names keep working.
+   */
+  const ContigSequence * resolve(const std::string & contig) const;
+protected:
+  void add_record(const std::string & name, std::unique_ptr<ContigSequence> && sequence);
+private:
+  std::vector<std::string> names;
+  std::vector<std::unique_ptr<ContigSequence>> sequences;
+  std::unordered_map<std::string, size_t> name_idx;
+};
+
+/**
+ * All records read into memory, packed to 2 bits per base.
+ */
+class InMemoryReference : public Reference
+{
+public:
+  bool load(const std::string & filename, hts_tpool * pool = nullptr);
+};
+
+/**
+ * Reference addressed through its .fai index, nothing is read up front. Uncompressed
+ * files are mapped into memory, bgzipped files are read with faidx_fetch_seq.
+ */
+class IndexedReference : public Reference
+{
+public:
+  IndexedReference() = default;
+  ~IndexedReference() override;
+
+  IndexedReference(const IndexedReference &) = delete;
+  IndexedReference & operator = (const IndexedReference &) = delete;
+
+  /**
+   * Returns false when a .fai record does not fit the file, e.g. a stale index - the
+   * reference is then read into memory by Reference::open instead.
+   */
+  bool load(const std::string & filename);
+private:
+  bool load_mapped(const std::string & filename);
+  bool load_faidx(const std::string & filename);
+
+  faidx_t * fai = nullptr;
+  std::mutex fai_mutex;
+
+  void * mapping = nullptr;
+  size_t mapping_length = 0;
+};
+
+#endif //VCF2EDS_REFERENCE_H
@@ -0,0 +1,120 @@
+#include "streaming_builder.h"
+#include "cluster_merger.h"
+#include "haplotype_merger.h"
+
+#include <algorithm>
+
+StreamingBuilder::StreamingBuilder(const Reference & reference, SegmentSink sink, bool phased)
+  : reference(reference), sink(std::move(sink)), phased(phased)
+{ }
+
+bool StreamingBuilder::add_variant(const VcfRecord & record)
+{
+  if (record.alt.empty() || record.alt[0][0] == '<')
+    return false;
+
+  if (positions == 0)
+  {
+    contig = record.chromosome;
+    sequence = reference.resolve(contig);
+    if (!sequence)
+      throw std::runtime_error("Contig " + contig + " is missing in the reference");
+  }
+  else if (record.chromosome != contig)
+    throw UnsortedInputError("Streaming conversion needs a single contig, found " + contig
+                             + " and " + record.chromosome);
+
+  std::unique_ptr<Segment> segment = std::make_unique<Segment>(record.position);
+  segment->add_reference(record.ref);
+  segment->intern_variants(begin(record.alt), end(record.alt));
+
+  if (!open_cluster.empty())
+  {
+    auto & last = open_cluster.back();
+    if (segment->start_position() < last->start_position())
+      throw UnsortedInputError("VCF is not sorted: position " + std::to_string(segment->start_position())
+                               + " follows " + std::to_string(last->start_position()));
+
+    if (segment->start_position() == last->start_position())
+    {
+      last->merge(*segment);
+      open_end = std::max(open_end, last->end_position());
+      if (phased)
+        open_records.push_back(record);
+      return true;
+    }
+
+    if (segment->start_position() > open_end)
+      flush();
+  }
+
+  positions++;
+  open_end = std::max(open_end, segment->end_position());
+  open_cluster.push_back(std::move(segment));
+  if (phased)
+    open_records.push_back(record);
+  return true;
+}
+
+std::unique_ptr<Segment> StreamingBuilder::merge_haplotypes()
+{
+  HaplotypeMerger haplotypes;
+  for (const auto & record : open_records)
+    haplotypes.add(record);
+  open_records.clear();
+
+  auto cluster = haplotypes.finish();
+  if (cluster)
+    phased_count++;
+  else
+    unphased_count++;
+
+  return cluster;
+}
+
+void StreamingBuilder::flush()
+{
+  max_cluster = std::max(max_cluster, open_cluster.size());
+
+  std::unique_ptr<Segment> merged;
+  if (phased)
+    merged = merge_haplotypes();
+
+  if (!merged)
+  {
+    ClusterMerger cluster(std::move(open_cluster.front()));
+    for (size_t i = 1; i < open_cluster.size(); ++i)
+      cluster.add(*open_cluster[i]);
+    merged = cluster.finish();
+  }
+
+  open_cluster.clear();
+  open_end = 0;
+  append_cluster(sink, processed_pos, *sequence, std::move(merged));
+}
+
+void StreamingBuilder::finish()
+{
+  if (!open_cluster.empty())
+    flush();
+}
+
+size_t StreamingBuilder::variant_positions() const
+{
+  return positions;
+}
+
+size_t StreamingBuilder::max_cluster_size() const
+{
+  return max_cluster;
+}
+
+size_t StreamingBuilder::phased_clusters() const
+{
+  return phased_count;
+}
+
+size_t StreamingBuilder::unphased_clusters() const
+{
+  return unphased_count;
+}
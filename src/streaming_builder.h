@@ -0,0 +1,70 @@
+#ifndef VCF2EDS_STREAMING_BUILDER_H
+#define VCF2EDS_STREAMING_BUILDER_H
+
+#include "converter.h"
+#include "eds.h"
+#include "reference.h"
+#include "vcf_reader.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Sweep-line counterpart of build_eds for coordinate-sorted input. Only the variants
+ * of the currently open overlap cluster are kept; the cluster, preceded by the reference
+ * before it, goes to the sink as soon as a record starts past its end. The emitted
+ * segments are the same as build_eds produces from the whole map. The reference record
+ * is resolved from the contig of the first record.
+ *
+ * In phased mode the records of a cluster are kept as well and the cluster lists only
+ * the haplotypes carried by the samples, see HaplotypeMerger. Clusters whose haplotypes
+ * cannot be resolved are merged as usual.
+ */
+class StreamingBuilder
+{
+public:
+  StreamingBuilder(const Reference & reference, SegmentSink sink, bool phased = false);
+
+  /**
+   * Returns false for skipped records, throws UnsortedInputError on unsorted input.
+   */
+  bool add_variant(const VcfRecord & record);
+
+  /**
+   * Flushes the open cluster.
+   */
+  void finish();
+
+  size_t variant_positions() const;
+  size_t max_cluster_size() const;
+
+  /**
+   * Clusters merged from haplotypes and clusters that fell back to padded alternatives.
+   */
+  size_t phased_clusters() const;
+  size_t unphased_clusters() const;
+private:
+  void flush();
+  std::unique_ptr<Segment> merge_haplotypes();
+
+  const Reference & reference;
+  const ContigSequence * sequence = nullptr;
+  SegmentSink sink;
+  size_t processed_pos = 1;
+
+  std::string contig;
+  std::vector<std::unique_ptr<Segment>> open_cluster;
+  size_t open_end = 0;
+
+  bool phased;
+  std::vector<VcfRecord> open_records;
+
+  size_t positions = 0;
+  size_t max_cluster = 0;
+  size_t phased_count = 0;
+  size_t unphased_count = 0;
+};
+
+#endif //VCF2EDS_STREAMING_BUILDER_H
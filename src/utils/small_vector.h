@@ -0,0 +1,183 @@
+#ifndef VCF2EDS_SMALL_VECTOR_H
+#define VCF2EDS_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Vector keeping up to N elements inside the object, it moves to the heap only
+ * when it grows larger.
+ */
+template<class T, size_t N>
+class SmallVector
+{
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  SmallVector() = default;
+
+  SmallVector(const SmallVector & other)
+  {
+    reserve(other.count);
+    std::uninitialized_copy(other.begin(), other.end(), data());
+    count = other.count;
+  }
+
+  SmallVector(SmallVector && other) noexcept
+  {
+    steal(other);
+  }
+
+  ~SmallVector()
+  {
+    clear();
+    release();
+  }
+
+  SmallVector & operator = (const SmallVector & other)
+  {
+    if (this != &other)
+    {
+      SmallVector copy(other);
+      clear();
+      release();
+      steal(copy);
+    }
+    return *this;
+  }
+
+  SmallVector & operator = (SmallVector && other) noexcept
+  {
+    if (this != &other)
+    {
+      clear();
+      release();
+      steal(other);
+    }
+    return *this;
+  }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + count; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + count; }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  T & operator [] (size_t idx) { return data()[idx]; }
+  const T & operator [] (size_t idx) const { return data()[idx]; }
+
+  void reserve(size_t new_capacity)
+  {
+    if (new_capacity <= capacity)
+      return;
+
+    T * new_heap = static_cast<T *>(::operator new(new_capacity * sizeof(T)));
+    std::uninitialized_copy(std::make_move_iterator(begin()), std::make_move_iterator(end()), new_heap);
+    size_t old_count = count;
+    clear();
+    release();
+    heap = new_heap;
+    capacity = new_capacity;
+    count = old_count;
+  }
+
+  template<class... Args>
+  iterator emplace(const_iterator pos, Args &&... args)
+  {
+    size_t idx = pos - begin();
+    // arguments may refer to an element, build the value before anything moves
+    T value(std::forward<Args>(args)...);
+    if (count == capacity)
+      reserve(capacity * 2);
+
+    T * items = data();
+    if (idx == count)
+    {
+      new (items + count) T(std::move(value));
+    }
+    else
+    {
+      new (items + count) T(std::move(items[count - 1]));
+      std::move_backward(items + idx, items + count - 1, items + count);
+      items[idx] = std::move(value);
+    }
+
+    ++count;
+    return items + idx;
+  }
+
+  iterator erase(const_iterator pos)
+  {
+    size_t idx = pos - begin();
+    T * items = data();
+    std::move(items + idx + 1, items + count, items + idx);
+    items[--count].~T();
+    return items + idx;
+  }
+
+  void push_back(T && value)
+  {
+    emplace(end(), std::move(value));
+  }
+
+  void clear()
+  {
+    for (auto & item : *this)
+      item.~T();
+    count = 0;
+  }
+
+  void swap(SmallVector & other)
+  {
+    SmallVector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+private:
+  T * data() { return heap ? heap : reinterpret_cast<T *>(&local); }
+  const T * data() const { return heap ? heap : reinterpret_cast<const T *>(&local); }
+
+  void release()
+  {
+    if (heap)
+      ::operator delete(heap);
+    heap = nullptr;
+    capacity = N;
+  }
+
+  // expects an empty vector with inline storage
+  void steal(SmallVector & other)
+  {
+    if (other.heap)
+    {
+      heap = other.heap;
+      capacity = other.capacity;
+      count = other.count;
+      other.heap = nullptr;
+      other.capacity = N;
+      other.count = 0;
+    }
+    else
+    {
+      std::uninitialized_copy(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()), data());
+      count = other.count;
+      other.clear();
+    }
+  }
+
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type local;
+  T * heap = nullptr;
+  size_t count = 0;
+  size_t capacity = N;
+};
+
+#endif //VCF2EDS_SMALL_VECTOR_H
@@ -0,0 +1,102 @@
+#ifndef VCF2EDS_SPSC_QUEUE_H
+#define VCF2EDS_SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * Bounded lock-free ring buffer between one producer and one consumer thread. push
+ * waits while the ring is full and pop while it is empty, spinning briefly before
+ * sleeping. After close() pushes are rejected and pops drain what is left; either
+ * side may close, e.g. a consumer giving up releases a waiting producer.
+ */
+template<class T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    slots.resize(size);
+    mask = size - 1;
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue & operator = (const SpscQueue &) = delete;
+
+  bool try_push(T && item)
+  {
+    size_t tail_value = tail.load(std::memory_order_relaxed);
+    if (tail_value - head.load(std::memory_order_acquire) == slots.size())
+      return false;
+
+    slots[tail_value & mask] = std::move(item);
+    tail.store(tail_value + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T & item)
+  {
+    size_t head_value = head.load(std::memory_order_relaxed);
+    if (head_value == tail.load(std::memory_order_acquire))
+      return false;
+
+    item = std::move(slots[head_value & mask]);
+    head.store(head_value + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool push(T && item)
+  {
+    for (size_t attempt = 0; ; ++attempt)
+    {
+      if (closed.load(std::memory_order_acquire))
+        return false;
+      if (try_push(std::move(item)))
+        return true;
+      wait(attempt);
+    }
+  }
+
+  bool pop(T & item)
+  {
+    for (size_t attempt = 0; ; ++attempt)
+    {
+      if (try_pop(item))
+        return true;
+      // items pushed before close are visible once closed is
+      if (closed.load(std::memory_order_acquire))
+        return try_pop(item);
+      wait(attempt);
+    }
+  }
+
+  void close()
+  {
+    closed.store(true, std::memory_order_release);
+  }
+private:
+  static void wait(size_t attempt)
+  {
+    if (attempt < 64)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  std::vector<T> slots;
+  size_t mask;
+  // head and tail are written by different threads, keep them on separate cache lines
+  std::atomic<size_t> head{0};
+  char head_padding[64];
+  std::atomic<size_t> tail{0};
+  char tail_padding[64];
+  std::atomic<bool> closed{false};
+};
+
+#endif //VCF2EDS_SPSC_QUEUE_H
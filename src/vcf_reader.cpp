@@ -0,0 +1,321 @@
+#include "vcf_reader.h"
+
+#include <vcflib/Variant.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+  /**
+   * Allele index of one call of a GT value, -1 for a missing or malformed one.
+   */
+  int32_t parse_call(const std::string & allele)
+  {
+    if (allele.empty() || !std::isdigit(static_cast<unsigned char>(allele.front())))
+      return -1;
+
+    char * end = nullptr;
+    long index = std::strtol(allele.c_str(), &end, 10);
+    if (*end != '\0' || index > INT32_MAX)
+      return -1;
+    return static_cast<int32_t>(index);
+  }
+
+  /**
+   * Appends the allele of each haplotype of a GT value - "0|1", "1/0", "./.", "2" - to
+   * calls, -1 for a missing or malformed one. Clears phased for an unphased
+   * heterozygous genotype.
+   */
+  void parse_genotype(const std::string & genotype, std::vector<int32_t> & calls, bool & phased)
+  {
+    size_t first = calls.size();
+    size_t begin = 0;
+    while (begin <= genotype.length())
+    {
+      size_t end = genotype.find_first_of("|/", begin);
+      if (end == std::string::npos)
+        end = genotype.length();
+
+      std::string allele = genotype.substr(begin, end - begin);
+      calls.push_back(parse_call(allele));
+      if (begin > 0 && genotype[begin - 1] == '/' && calls.back() != calls[first])
+        phased = false;
+
+      begin = end + 1;
+    }
+  }
+}
+
+VcfReader::Backend VcfReader::parse_backend(const std::string & name)
+{
+  if (name == "htslib")
+    return Backend::htslib;
+  if (name == "vcflib")
+    return Backend::vcflib;
+
+  throw std::invalid_argument("Unknown VCF backend: " + name);
+}
+
+std::unique_ptr<VcfReader> VcfReader::open(const std::string & filename, Backend backend,
+                                           hts_tpool * pool, bool genotypes)
+{
+  if (backend == Backend::vcflib)
+    return std::make_unique<VcflibReader>(filename, genotypes);
+
+  return std::make_unique<HtslibReader>(filename, pool, genotypes);
+}
+
+HtslibReader::HtslibReader(const std::string & filename, hts_tpool * pool, bool genotypes)
+  : genotypes(genotypes)
+{
+  // hts_open detects VCF, bgzipped VCF and BCF from the file content
+  file = hts_open(filename.c_str(), "r");
+  if (!file)
+    return;
+
+  if (pool)
+  {
+    htsThreadPool thread_pool = {pool, 0};
+    hts_set_opt(file, HTS_OPT_THREAD_POOL, &thread_pool);
+  }
+
+  header = bcf_hdr_read(file);
+  if (!header)
+  {
+    hts_close(file);
+    file = nullptr;
+    return;
+  }
+
+  // "-" excludes every sample - records are parsed up to FORMAT only
+  if (!genotypes)
+    bcf_hdr_set_samples(header, "-", 0);
+  line = bcf_init();
+}
+
+HtslibReader::~HtslibReader()
+{
+  free(buffer.s);
+  free(genotype_buffer);
+  if (iterator)
+    hts_itr_destroy(iterator);
+  if (tbx)
+    tbx_destroy(tbx);
+  if (index)
+    hts_idx_destroy(index);
+  if (line)
+    bcf_destroy(line);
+  if (header)
+    bcf_hdr_destroy(header);
+  if (file)
+    hts_close(file);
+}
+
+bool HtslibReader::is_open() const
+{
+  return file != nullptr;
+}
+
+bool HtslibReader::next(VcfRecord & record)
+{
+  int ret;
+  if (!region_set)
+    ret = bcf_read(file, header, line);
+  else if (!iterator)
+    ret = -1;
+  else if (is_bcf())
+    ret = bcf_itr_next(file, iterator, line);
+  else
+  {
+    ret = tbx_itr_next(file, tbx, iterator, &buffer);
+    if (ret >= 0 && vcf_parse(&buffer, header, line) < 0)
+      ret = -2;
+  }
+
+  if (ret == -1)
+    return false;
+  if (ret < -1)
+    throw std::runtime_error("Malformed VCF/BCF record");
+
+  bcf_unpack(line, BCF_UN_STR);
+
+  record.chromosome = bcf_seqname(header, line);
+  record.position = line->pos + 1;
+  record.ref = line->d.allele[0];
+  record.alt.assign(line->d.allele + 1, line->d.allele + line->n_allele);
+  if (genotypes)
+    read_genotypes(record);
+
+  return true;
+}
+
+void HtslibReader::read_genotypes(VcfRecord & record)
+{
+  record.haplotypes.clear();
+  record.phased = true;
+
+  int count = bcf_get_genotypes(header, line, &genotype_buffer, &genotype_capacity);
+  int samples = bcf_hdr_nsamples(header);
+  if (count <= 0 || samples == 0)
+    return;
+
+  int ploidy = count / samples;
+  record.haplotypes.resize(count);
+  for (int sample = 0; sample < samples; ++sample)
+  {
+    int32_t * calls = genotype_buffer + sample * ploidy;
+    for (int i = 0; i < ploidy; ++i)
+    {
+      // shorter genotypes of mixed ploidy are padded with vector_end
+      int32_t allele = (calls[i] == bcf_int32_vector_end || bcf_gt_is_missing(calls[i]))
+              ? -1 : bcf_gt_allele(calls[i]);
+      record.haplotypes[sample * ploidy + i] = allele;
+
+      // the phase is stored with the second and later alleles
+      if (i > 0 && allele != record.haplotypes[sample * ploidy] && !bcf_gt_is_phased(calls[i]))
+        record.phased = false;
+    }
+  }
+}
+
+bool HtslibReader::is_bcf() const
+{
+  return hts_get_format(file)->format == bcf;
+}
+
+void HtslibReader::load_index()
+{
+  if (tbx || index)
+    return;
+
+  if (is_bcf())
+    index = bcf_index_load(file->fn);
+  else
+    tbx = tbx_index_load(file->fn);
+
+  if (!tbx && !index)
+    throw std::runtime_error(std::string("Could not load index of ") + file->fn);
+}
+
+std::vector<std::string> HtslibReader::index_contigs()
+{
+  load_index();
+
+  int count = 0;
+  const char ** names = tbx
+          ? tbx_seqnames(tbx, &count)
+          : bcf_index_seqnames(index, header, &count);
+
+  std::vector<std::string> contigs(names, names + count);
+  free(names);
+  return contigs;
+}
+
+bool HtslibReader::set_region(const std::string & region)
+{
+  load_index();
+
+  if (iterator)
+    hts_itr_destroy(iterator);
+
+  iterator = tbx
+          ? tbx_itr_querys(tbx, region.c_str())
+          : bcf_itr_querys(index, header, region.c_str());
+  region_set = true;
+
+  return iterator != nullptr;
+}
+
+VcflibReader::VcflibReader(const std::string & filename, bool genotypes)
+  : file(std::make_unique<vcflib::VariantCallFile>()), genotypes(genotypes)
+{
+  file->open(filename);
+  if (file->is_open())
+    variant = std::make_unique<vcflib::Variant>(*file);
+}
+
+VcflibReader::~VcflibReader() = default;
+
+bool VcflibReader::is_open() const
+{
+  return file->is_open();
+}
+
+bool VcflibReader::next(VcfRecord & record)
+{
+  if (!file->getNextVariant(*variant))
+    return false;
+
+  record.chromosome = variant->sequenceName;
+  record.position = variant->position;
+  record.ref = variant->ref;
+  record.alt = variant->alt;
+  if (genotypes)
+    read_genotypes(record);
+
+  return true;
+}
+
+void VcflibReader::read_genotypes(VcfRecord & record)
+{
+  record.haplotypes.clear();
+  record.phased = true;
+
+  // calls of sample i are calls[call_begin[i], call_begin[i + 1])
+  std::vector<int32_t> calls;
+  std::vector<size_t> call_begin{0};
+  size_t ploidy = 0;
+  for (const auto & sample_name : file->sampleNames)
+  {
+    auto sample = variant->samples.find(sample_name);
+    if (sample != variant->samples.end())
+    {
+      auto gt = sample->second.find("GT");
+      if (gt != sample->second.end() && !gt->second.empty())
+        parse_genotype(gt->second.front(), calls, record.phased);
+    }
+
+    call_begin.push_back(calls.size());
+    ploidy = std::max(ploidy, call_begin.back() - call_begin[call_begin.size() - 2]);
+  }
+
+  if (ploidy == 0)
+    return;
+
+  // same layout as HtslibReader - ploidy slots per sample, missing samples and the
+  // tail of shorter genotypes are -1
+  size_t samples = call_begin.size() - 1;
+  record.haplotypes.assign(samples * ploidy, -1);
+  for (size_t sample = 0; sample < samples; ++sample)
+    std::copy(calls.begin() + call_begin[sample], calls.begin() + call_begin[sample + 1],
+              record.haplotypes.begin() + sample * ploidy);
+}
+
+uint64_t HtslibReader::region_weight(const std::string & contig, size_t begin, size_t end)
+{
+  load_index();
+
+  int tid = tbx ? tbx_name2id(tbx, contig.c_str()) : bcf_hdr_name2id(header, contig.c_str());
+  if (tid < 0)
+    return 0;
+
+  hts_itr_t * region_iterator = tbx
+          ? tbx_itr_queryi(tbx, tid, begin - 1, end)
+          : bcf_itr_queryi(index, tid, begin - 1, end);
+  if (!region_iterator)
+    return 0;
+
+  uint64_t weight = 0;
+  for (int i = 0; i < region_iterator->n_off; ++i)
+  {
+    // virtual offsets - the upper 48 bits address the compressed block
+    weight += (region_iterator->off[i].v >> 16) - (region_iterator->off[i].u >> 16) + 1;
+  }
+
+  hts_itr_destroy(region_iterator);
+  return weight;
+}
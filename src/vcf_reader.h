@@ -0,0 +1,142 @@
+#ifndef VCF2EDS_VCF_READER_H
+#define VCF2EDS_VCF_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <htslib/tbx.h>
+#include <htslib/thread_pool.h>
+#include <htslib/vcf.h>
+
+namespace vcflib
+{
+  class VariantCallFile;
+  class Variant;
+}
+
+/**
+ * Site level view of one VCF line - the only part of a record the conversion needs.
+ */
+struct VcfRecord
+{
+  std::string chromosome;
+  size_t position = 0;
+  std::string ref;
+  std::vector<std::string> alt;
+
+  // only filled when the reader was asked for genotypes: allele index carried by each
+  // haplotype, sample after sample, -1 when the call is missing
+  std::vector<int32_t> haplotypes;
+  // false when some sample has an unphased genotype with different alleles
+  bool phased = true;
+};
+
+/**
+ * Thrown when records do not come in coordinate order.
+ */
+class UnsortedInputError : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+class VcfReader
+{
+public:
+  enum class Backend
+  {
+    htslib,
+    vcflib
+  };
+
+  virtual ~VcfReader() = default;
+
+  virtual bool is_open() const = 0;
+  virtual bool next(VcfRecord & record) = 0;
+
+  static Backend parse_backend(const std::string & name);
+  /**
+   * Genotypes are decoded only when asked for, otherwise records carry sites only.
+   */
+  static std::unique_ptr<VcfReader> open(const std::string & filename, Backend backend,
+                                         hts_tpool * pool = nullptr, bool genotypes = false);
+};
+
+/**
+ * Reads VCF or BCF through htslib. Unless genotypes are requested, sample columns are
+ * dropped from the header, so neither the text parser nor BCF unpacking ever decodes
+ * FORMAT data. BGZF decompression runs on the given thread pool when there is one.
+ */
+class HtslibReader : public VcfReader
+{
+public:
+  explicit HtslibReader(const std::string & filename, hts_tpool * pool = nullptr, bool genotypes = false);
+  ~HtslibReader() override;
+
+  HtslibReader(const HtslibReader &) = delete;
+  HtslibReader & operator = (const HtslibReader &) = delete;
+
+  bool is_open() const override;
+  bool next(VcfRecord & record) override;
+
+  /**
+   * Contigs present in the tabix (VCF) or CSI (BCF) index, in index order.
+   * Throws when the file has no index.
+   */
+  std::vector<std::string> index_contigs();
+
+  /**
+   * Restricts reading to the given region ("22", "22:1000-2000"). Returns false
+   * when the contig is not in the index, in which case nothing is read.
+   */
+  bool set_region(const std::string & region);
+
+  /**
+   * Estimates how much data the index holds for [begin, end] (1-based, inclusive)
+   * as the number of compressed bytes its chunks span.
+   */
+  uint64_t region_weight(const std::string & contig, size_t begin, size_t end);
+private:
+  bool is_bcf() const;
+  void load_index();
+  void read_genotypes(VcfRecord & record);
+
+  htsFile * file = nullptr;
+  bcf_hdr_t * header = nullptr;
+  bcf1_t * line = nullptr;
+
+  tbx_t * tbx = nullptr;
+  hts_idx_t * index = nullptr;
+  hts_itr_t * iterator = nullptr;
+  kstring_t buffer = {0, 0, nullptr};
+  bool region_set = false;
+
+  bool genotypes;
+  int32_t * genotype_buffer = nullptr;
+  int genotype_capacity = 0;
+};
+
+/**
+ * Fallback reader built on vcflib, parses the whole record including samples.
+ */
+class VcflibReader : public VcfReader
+{
+public:
+  explicit VcflibReader(const std::string & filename, bool genotypes = false);
+  ~VcflibReader() override;
+
+  bool is_open() const override;
+  bool next(VcfRecord & record) override;
+private:
+  void read_genotypes(VcfRecord & record);
+
+  std::unique_ptr<vcflib::VariantCallFile> file;
+  std::unique_ptr<vcflib::Variant> variant;
+  bool genotypes;
+};
+
+#endif //VCF2EDS_VCF_READER_H
@@ -0,0 +1,122 @@
+#include "eds.h"
+#include "eds_format.h"
+#include "test_utils.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Writes tests/data/expected.eds in the binary format and reads it back, from memory
+ * and from a file, then checks that corrupt headers and truncated containers are
+ * rejected instead of being trusted.
+ *
+ * usage: binary_test <data directory> <work directory>
+ */
+namespace
+{
+  std::string save(const EDS & eds, EDS::Format format = EDS::Format::text)
+  {
+    std::ostringstream os;
+    eds.save(os, format);
+    return os.str();
+  }
+
+  void test_round_trip(const EDS & eds, const std::string & expected, const std::string & work_dir)
+  {
+    std::string binary = save(eds, EDS::Format::binary);
+    std::istringstream is(binary);
+    check(BinaryEdsHeader::detect(is), "binary container detected");
+
+    EDS loaded;
+    loaded.load(is);
+    check(save(loaded) == expected, "binary round trip");
+    check(save(loaded, EDS::Format::binary) == binary, "binary output of a loaded binary EDS");
+
+    std::string binary_file = work_dir + "/expected.edsb";
+    std::ofstream(binary_file, std::ios::binary) << binary;
+    EDS from_file;
+    check(from_file.load_file(binary_file) && save(from_file) == expected, "binary round trip through a file");
+  }
+
+  /**
+   * Replaces the u64 header field at offset with value.
+   */
+  std::string patch(std::string binary, size_t offset, uint64_t value)
+  {
+    std::string field;
+    append_le64(field, value);
+    binary.replace(offset, field.length(), field);
+    return binary;
+  }
+
+  void test_corrupt(const EDS & eds)
+  {
+    std::string binary = save(eds, EDS::Format::binary);
+    BinaryEdsHeader header;
+    size_t header_size = header.parse(binary.data(), binary.length());
+
+    // the fields end the header: reference length, segment count, total size,
+    // largest number of alternatives, payload size
+    size_t fields = header_size - 40;
+    struct Case
+    {
+      std::string what;
+      std::string data;
+    };
+    Case cases[] = {
+      {"segment count beyond the payload", patch(binary, fields + 8, header.payload_size / 16 + 1)},
+      {"huge segment count", patch(binary, fields + 8, static_cast<uint64_t>(-1) / 8)},
+      {"reference beyond the payload", patch(binary, fields, header.payload_size + 1)},
+      {"payload size beyond the stream", patch(binary, fields + 32, static_cast<uint64_t>(1) << 40)},
+      {"truncated payload", binary.substr(0, binary.length() - 1)},
+    };
+
+    for (const auto & corrupt : cases)
+    {
+      std::istringstream is(corrupt.data);
+      EDS loaded;
+      bool thrown = false;
+      try
+      {
+        loaded.load(is);
+      }
+      catch (const std::runtime_error &)
+      {
+        thrown = true;
+      }
+      check(thrown, corrupt.what + " is rejected");
+    }
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: binary_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string data_dir = argv[1];
+  try
+  {
+    std::string expected = read_file(data_dir + "/expected.eds");
+    if (expected.empty())
+      throw std::runtime_error("Missing test data in " + data_dir);
+
+    std::istringstream is(expected);
+    EDS eds;
+    eds.load(is);
+    test_round_trip(eds, expected, argv[2]);
+    test_corrupt(eds);
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
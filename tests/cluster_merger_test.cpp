@@ -0,0 +1,79 @@
+#include "cluster_merger.h"
+#include "eds.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Merges random clusters of overlapping SNVs and indels with ClusterMerger and
+ * pairwise with Segment::merge, both must yield the same segment.
+ */
+namespace
+{
+  std::string write(const Segment & segment)
+  {
+    std::ostringstream os;
+    os << segment << "@" << segment.start_position();
+    return os.str();
+  }
+
+  /**
+   * Segments in order of their start positions, each overlapping the ones before.
+   * References are taken from genome, alternatives are deletions, insertions and
+   * substitutions of up to four bases.
+   */
+  std::vector<std::unique_ptr<Segment>> random_cluster(std::mt19937 & rng, const std::string & genome)
+  {
+    std::vector<std::unique_ptr<Segment>> segments;
+    size_t start = 1 + rng() % 20;
+    size_t end = start;
+    for (size_t count = 1 + rng() % 8; count > 0; --count)
+    {
+      size_t previous = segments.empty() ? start : segments.back()->start_position();
+      size_t position = previous + rng() % (end - previous + 1);
+      size_t length = 1 + (rng() % 5 == 0 ? rng() % 30 : rng() % 3);
+
+      auto segment = std::make_unique<Segment>(position);
+      segment->add_reference(genome.substr(position - 1, length));
+      for (size_t alternatives = 1 + rng() % 3; alternatives > 0; --alternatives)
+        segment->add_variant(random_bases(rng, rng() % 5));
+
+      end = std::max(end, segment->end_position());
+      segments.push_back(std::move(segment));
+    }
+    return segments;
+  }
+
+  void test_random(std::mt19937 & rng)
+  {
+    for (int round = 0; round < 5000; ++round)
+    {
+      std::string genome = random_bases(rng, 200);
+      auto segments = random_cluster(rng, genome);
+
+      auto pairwise = std::make_unique<Segment>(*segments[0]);
+      ClusterMerger merger(std::make_unique<Segment>(*segments[0]));
+      for (size_t i = 1; i < segments.size() && segments[i]->start_position() <= pairwise->end_position(); ++i)
+      {
+        pairwise->merge(*segments[i]);
+        merger.add(*segments[i]);
+        check(merger.end_position() == pairwise->end_position(), "cluster end while merging");
+      }
+
+      auto merged = merger.finish();
+      check(write(*merged) == write(*pairwise), "cluster of " + std::to_string(segments.size()) + " segments");
+    }
+  }
+}
+
+int main()
+{
+  std::mt19937 rng(13);
+  test_random(rng);
+  return test_result();
+}
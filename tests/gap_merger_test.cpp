@@ -0,0 +1,156 @@
+#include "eds.h"
+#include "gap_merger.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Joins segments with GapMerger - segments are joined only while the growth of the
+ * text output stays within the cap, the joined output spells the same strings as the
+ * input and saved_segments() counts the segments that were joined away.
+ */
+namespace
+{
+  using Alleles = std::vector<std::string>;
+
+  struct Output
+  {
+    std::vector<Alleles> segments;
+    size_t bytes = 0;
+  };
+
+  std::string write(const Segment & segment)
+  {
+    std::ostringstream os;
+    os << segment;
+    return os.str();
+  }
+
+  Alleles alleles(const Segment & segment)
+  {
+    Alleles result{segment.get_reference()};
+    for (const auto & variant : segment.get_variants())
+      result.push_back(variant.str());
+    return result;
+  }
+
+  /**
+   * Every string spelled by choosing one allele of each segment.
+   */
+  std::set<std::string> spelled(const std::vector<Alleles> & segments)
+  {
+    std::set<std::string> strings{""};
+    for (const auto & segment : segments)
+    {
+      std::set<std::string> extended;
+      for (const auto & prefix : strings)
+        for (const auto & allele : segment)
+          extended.insert(prefix + allele);
+      strings.swap(extended);
+    }
+    return strings;
+  }
+
+  std::unique_ptr<Segment> make_segment(size_t position, const std::string & reference, const Alleles & variants = {})
+  {
+    auto segment = std::make_unique<Segment>(position, std::string(reference));
+    for (const auto & variant : variants)
+      segment->add_variant(variant);
+    return segment;
+  }
+
+  /**
+   * {A,C}GT{T,G} grows by 9 bytes when written as one segment.
+   */
+  void test_cap()
+  {
+    for (size_t max_growth : {8, 9})
+    {
+      Output output;
+      GapMerger merger(2, max_growth, [&output](std::unique_ptr<Segment> && segment)
+      {
+        output.segments.push_back(alleles(*segment));
+        output.bytes += write(*segment).length();
+      });
+      merger.add(make_segment(1, "A", {"C"}));
+      merger.add(make_segment(2, "GT"));
+      merger.add(make_segment(4, "T", {"G"}));
+      merger.finish();
+
+      std::string what = "growth of 9 bytes with a cap of " + std::to_string(max_growth);
+      if (max_growth < 9)
+      {
+        check(output.segments.size() == 3 && merger.saved_segments() == 0, what + ", kept apart");
+        continue;
+      }
+
+      check(output.segments.size() == 1 && merger.saved_segments() == 2, what + ", joined");
+      check(output.bytes == 12 + 9, what + ", output size");
+      check(spelled(output.segments) == std::set<std::string>({"AGTT", "AGTG", "CGTT", "CGTG"}), what + ", alleles");
+    }
+
+    GapMerger merger(1, 1000, [](std::unique_ptr<Segment> &&) { });
+    merger.add(make_segment(1, "A", {"C"}));
+    merger.add(make_segment(2, "GT"));
+    merger.add(make_segment(4, "T", {"G"}));
+    merger.finish();
+    check(merger.saved_segments() == 0, "gap longer than max_gap");
+  }
+
+  void test_random(std::mt19937 & rng)
+  {
+    for (int round = 0; round < 3000; ++round)
+    {
+      size_t max_gap = rng() % 4;
+      size_t max_growth = rng() % 80;
+      Output output;
+      GapMerger merger(max_gap, max_growth, [&output](std::unique_ptr<Segment> && segment)
+      {
+        output.segments.push_back(alleles(*segment));
+        output.bytes += write(*segment).length();
+      });
+
+      // reference segments never follow each other
+      std::vector<Alleles> input;
+      size_t input_bytes = 0;
+      size_t position = 1;
+      bool degenerate = rng() % 2;
+      for (size_t count = 1 + rng() % 7; count > 0; --count)
+      {
+        std::string reference = random_bases(rng, 1 + rng() % 4);
+        Alleles variants;
+        if (degenerate)
+        {
+          for (size_t alternatives = 1 + rng() % 3; alternatives > 0; --alternatives)
+            variants.push_back(random_bases(rng, 1 + rng() % 2));
+          variants.push_back(reference + "A");
+        }
+
+        auto segment = make_segment(position, reference, variants);
+        input.push_back(alleles(*segment));
+        input_bytes += write(*segment).length();
+        position += reference.length();
+        merger.add(std::move(segment));
+        degenerate = !degenerate || rng() % 2;
+      }
+      merger.finish();
+
+      check(spelled(output.segments) == spelled(input), "joined segments spell the input");
+      check(input.size() - output.segments.size() == merger.saved_segments(), "saved segments");
+      check(output.bytes <= input_bytes + merger.saved_segments() * max_growth, "growth within the cap");
+    }
+  }
+}
+
+int main()
+{
+  std::mt19937 rng(15);
+  test_cap();
+  test_random(rng);
+  return test_result();
+}
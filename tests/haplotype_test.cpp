@@ -0,0 +1,172 @@
+#include "eds.h"
+#include "haplotype_merger.h"
+#include "reference.h"
+#include "streaming_builder.h"
+#include "test_utils.h"
+#include "vcf_reader.h"
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Merges clusters into the haplotypes of their samples with HaplotypeMerger and the
+ * phased StreamingBuilder, and checks the fallback to padded alternatives when the
+ * haplotypes cannot be resolved.
+ *
+ * usage: haplotype_test <data directory> <work directory>
+ */
+namespace
+{
+  /**
+   * Bases of the single contig of a FASTA file.
+   */
+  std::string read_genome(const std::string & fasta_file)
+  {
+    std::istringstream is(read_file(fasta_file));
+    std::string genome;
+    std::string line;
+    while (std::getline(is, line))
+    {
+      if (!line.empty() && line.front() != '>')
+        genome += line;
+    }
+    return genome;
+  }
+
+  VcfRecord make_record(const std::string & genome, size_t position, size_t length, const std::string & alt,
+                        std::vector<int32_t> haplotypes, bool phased = true)
+  {
+    VcfRecord record;
+    record.chromosome = "1";
+    record.position = position;
+    record.ref = genome.substr(position - 1, length);
+    record.alt = {alt};
+    record.haplotypes = std::move(haplotypes);
+    record.phased = phased;
+    return record;
+  }
+
+  std::vector<std::string> variants(const Segment & segment)
+  {
+    std::vector<std::string> result;
+    for (const auto & variant : segment.get_variants())
+      result.push_back(variant.str());
+    return result;
+  }
+
+  /**
+   * Two samples over a deletion at 3 and the SNVs at 4 and 5 it spans, the first
+   * haplotype of the second sample is the reference and is dropped.
+   */
+  std::vector<VcfRecord> phased_cluster(const std::string & genome)
+  {
+    return {make_record(genome, 3, 3, "T", {1, 0, 0, 0}), make_record(genome, 4, 1, "G", {0, 1, 0, 1}),
+            make_record(genome, 5, 1, "C", {0, 1, 0, 0})};
+  }
+
+  /**
+   * A deletion at 20 and an SNV at 21, unphased and heterozygous in both records.
+   */
+  std::vector<VcfRecord> unphased_cluster(const std::string & genome, bool genotypes = true)
+  {
+    if (!genotypes)
+      return {make_record(genome, 20, 2, "C", {}), make_record(genome, 21, 1, "G", {})};
+    return {make_record(genome, 20, 2, "C", {0, 1, 0, 0}, false), make_record(genome, 21, 1, "G", {1, 0, 0, 0}, false)};
+  }
+
+  void test_haplotypes(const std::string & genome)
+  {
+    HaplotypeMerger merger;
+    for (const auto & record : phased_cluster(genome))
+      merger.add(record);
+
+    auto segment = merger.finish();
+    check(segment != nullptr, "phased cluster is resolved");
+    if (!segment)
+      return;
+
+    check(segment->start_position() == 3 && segment->get_reference() == genome.substr(2, 3), "cluster reference");
+    check(variants(*segment) == std::vector<std::string>({"T", "TGA", "TGC"}), "haplotypes of the samples");
+  }
+
+  void test_fallback(const std::string & genome)
+  {
+    HaplotypeMerger unphased;
+    for (const auto & record : unphased_cluster(genome))
+      unphased.add(record);
+    check(unphased.finish() == nullptr, "unphased heterozygous calls in two records");
+
+    HaplotypeMerger no_genotypes;
+    for (const auto & record : unphased_cluster(genome, false))
+      no_genotypes.add(record);
+    check(no_genotypes.finish() == nullptr, "cluster without genotypes");
+  }
+
+  /**
+   * The phased builder lists the haplotypes of the first cluster and pads the second
+   * one like the unphased builder does.
+   */
+  void test_streaming(const Reference & reference, const std::string & genome)
+  {
+    auto records = phased_cluster(genome);
+    for (const auto & record : unphased_cluster(genome))
+      records.push_back(record);
+
+    std::vector<std::unique_ptr<Segment>> clusters[2];
+    for (bool phased : {false, true})
+    {
+      auto & output = clusters[phased];
+      StreamingBuilder builder(reference, [&output](std::unique_ptr<Segment> && segment)
+      {
+        if (!segment->get_variants().empty())
+          output.push_back(std::move(segment));
+      }, phased);
+      for (const auto & record : records)
+        builder.add_variant(record);
+      builder.finish();
+
+      if (phased)
+        check(builder.phased_clusters() == 1 && builder.unphased_clusters() == 1, "phased builder cluster counts");
+    }
+
+    check(clusters[1].size() == 2 && clusters[0].size() == 2, "phased builder clusters");
+    if (clusters[1].size() != 2 || clusters[0].size() != 2)
+      return;
+
+    check(variants(*clusters[1][0]) == std::vector<std::string>({"T", "TGA", "TGC"}), "phased builder haplotypes");
+    check(variants(*clusters[1][1]) == variants(*clusters[0][1])
+            && clusters[1][1]->get_reference() == clusters[0][1]->get_reference(), "phased builder fallback");
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: haplotype_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string data_dir = argv[1];
+  try
+  {
+    auto reference = Reference::open(data_dir + "/ref.fa");
+    std::string genome = read_genome(data_dir + "/ref.fa");
+    if (!reference || genome.empty())
+      throw std::runtime_error("Missing test data in " + data_dir);
+
+    test_haplotypes(genome);
+    test_fallback(genome);
+    test_streaming(*reference, genome);
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
@@ -0,0 +1,152 @@
+#include "bgzf_stream.h"
+#include "eds.h"
+#include "eds_index.h"
+#include "eds_pipeline.h"
+#include "hts_thread_pool.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Writes a synthetic EDS spanning many BGZF blocks with a multithreaded compressor and
+ * an index, then seeks to every checkpoint of the index and compares the segments
+ * read with the EDS written.
+ *
+ * usage: index_test <data directory> <work directory>
+ */
+namespace
+{
+  constexpr int threads = 4;
+  constexpr size_t index_stride = 1024;
+  constexpr size_t eds_size = 8 << 20;
+  // segments compared after each checkpoint
+  constexpr size_t segments_read = 3;
+
+  /**
+   * Reference runs alternating with degenerate segments, some of them insertions with
+   * an empty reference.
+   */
+  EDS random_eds(std::mt19937 & rng)
+  {
+    EDS eds;
+    eds.set_contig("1");
+    size_t position = 1;
+    size_t size = 0;
+    while (size < eds_size)
+    {
+      std::string run = random_bases(rng, 20 + rng() % 400);
+      size += run.length();
+      eds.add_segment(Segment(position, std::string(run)));
+      position += run.length();
+
+      Segment segment(position, random_bases(rng, rng() % 4 == 0 ? 0 : 1 + rng() % 6));
+      for (size_t variants = 1 + rng() % 4; variants > 0; --variants)
+        segment.add_variant(random_bases(rng, rng() % 8));
+      size += segment.length() + 16;
+      position += segment.length();
+      eds.add_segment(segment);
+    }
+    return eds;
+  }
+
+  template<class SegmentType>
+  std::string text(const SegmentType & segment)
+  {
+    std::ostringstream os;
+    os << segment;
+    return os.str();
+  }
+
+  void check_checkpoints(const std::string & filename, const EDS & eds, hts_tpool * pool, const std::string & what)
+  {
+    auto reader = IndexedEdsReader::open(filename, pool);
+    check(reader != nullptr, what + ", open");
+    if (!reader)
+      return;
+
+    const auto * contig = reader->get_index().find("1");
+    check(contig && contig->segment_count == eds.size() && contig->checkpoints.size() > 1, what + ", index");
+    if (!contig)
+      return;
+
+    for (const auto & checkpoint : contig->checkpoints)
+    {
+      std::string where = what + ", checkpoint at " + std::to_string(checkpoint.position);
+      check(reader->seek("1", checkpoint.position), where + ", seek");
+
+      Segment segment;
+      for (size_t i = checkpoint.segment; i < std::min(checkpoint.segment + segments_read, eds.size()); ++i)
+      {
+        bool read = reader->next(segment);
+        check(read && segment.start_position() == eds.segment(i).start_position()
+                && text(segment) == text(eds.segment(i)), where + ", segment " + std::to_string(i));
+        if (!read)
+          break;
+      }
+    }
+  }
+
+  void test_save(const EDS & eds, EDS::Format format, const std::string & filename, hts_tpool * pool,
+                 const std::string & what)
+  {
+    EdsIndex index(index_stride, format == EDS::Format::binary);
+    BgzfOutputStream os(filename, pool);
+    eds.save(os, format, &index, threads);
+    check(os.close() && index.save(filename + ".edsi"), what + ", write");
+    check_checkpoints(filename, eds, pool, what);
+  }
+
+  void test_pipelined(const EDS & eds, const std::string & filename, hts_tpool * pool)
+  {
+    EdsIndex index(index_stride);
+    BgzfOutputStream os(filename, pool);
+    index.begin_contig("1");
+    {
+      PipelinedEdsWriter writer(os, &index);
+      for (auto segment : eds)
+      {
+        auto copy = std::make_unique<Segment>(segment.start_position(), segment.reference().str());
+        for (size_t i = 0; i < segment.variant_count(); ++i)
+          copy->add_variant(segment.variant(i).str());
+        writer.add(std::move(copy));
+      }
+      writer.finish();
+    }
+    check(os.close() && index.save(filename + ".edsi"), "pipelined text, write");
+    check_checkpoints(filename, eds, pool, "pipelined text");
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: index_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string work_dir = argv[2];
+  std::mt19937 rng(19);
+  EDS eds = random_eds(rng);
+  HtsThreadPool thread_pool(threads);
+
+  try
+  {
+    test_save(eds, EDS::Format::text, work_dir + "/indexed.eds.gz", thread_pool.get(), "text");
+    test_save(eds, EDS::Format::binary, work_dir + "/indexed.edsb.gz", thread_pool.get(), "binary");
+    test_pipelined(eds, work_dir + "/pipelined.eds.gz", thread_pool.get());
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
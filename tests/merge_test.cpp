@@ -0,0 +1,153 @@
+#include "merged_reader.h"
+#include "test_utils.h"
+#include "vcf_reader.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * Merges sorted record lists with MergedVcfReader - records repeated across inputs
+ * are collapsed into one carrying the genotypes of every input they were found in.
+ */
+namespace
+{
+  class ListReader : public VcfReader
+  {
+  public:
+    explicit ListReader(std::vector<VcfRecord> records)
+      : records(std::move(records))
+    { }
+
+    bool is_open() const override
+    {
+      return true;
+    }
+
+    bool next(VcfRecord & record) override
+    {
+      if (next_idx == records.size())
+        return false;
+      record = records[next_idx++];
+      return true;
+    }
+  private:
+    std::vector<VcfRecord> records;
+    size_t next_idx = 0;
+  };
+
+  VcfRecord make_record(const std::string & contig, size_t position, const std::string & ref, const std::string & alt,
+                        std::vector<int32_t> haplotypes = {})
+  {
+    VcfRecord record;
+    record.chromosome = contig;
+    record.position = position;
+    record.ref = ref;
+    record.alt = {alt};
+    record.haplotypes = std::move(haplotypes);
+    return record;
+  }
+
+  std::vector<VcfRecord> merge(std::vector<std::vector<VcfRecord>> inputs, size_t & duplicates)
+  {
+    std::vector<std::unique_ptr<VcfReader>> readers;
+    for (auto & input : inputs)
+      readers.push_back(std::make_unique<ListReader>(std::move(input)));
+
+    MergedVcfReader merged(std::move(readers));
+    std::vector<VcfRecord> records;
+    VcfRecord record;
+    while (merged.next(record))
+      records.push_back(record);
+    duplicates = merged.duplicates();
+    return records;
+  }
+
+  /**
+   * Three inputs with one haplotype pair each, the site at 5 is in all of them.
+   */
+  void test_genotypes()
+  {
+    size_t duplicates = 0;
+    auto records = merge({{make_record("1", 5, "A", "C", {0, 1}), make_record("1", 9, "G", "T", {1, 1})},
+                          {make_record("1", 5, "A", "G", {1, 0}), make_record("1", 5, "A", "C", {1, 1})},
+                          {make_record("1", 5, "A", "C", {0, 0}), make_record("2", 3, "T", "A", {1, 0})}},
+                         duplicates);
+
+    check(records.size() == 4 && duplicates == 2, "three inputs, sites collapsed");
+    if (records.size() != 4)
+      return;
+
+    check(records[0].position == 5 && records[0].alt[0] == "C"
+            && records[0].haplotypes == std::vector<int32_t>({0, 1, 1, 1, 0, 0}), "site of all inputs");
+    check(records[1].position == 5 && records[1].alt[0] == "G"
+            && records[1].haplotypes == std::vector<int32_t>({-1, -1, 1, 0, -1, -1}), "other alternative kept");
+    check(records[2].position == 9 && records[2].haplotypes == std::vector<int32_t>({1, 1, -1, -1, -1, -1}),
+          "site of the first input");
+    check(records[3].chromosome == "2" && records[3].haplotypes == std::vector<int32_t>({-1, -1, -1, -1, 1, 0}),
+          "next contig");
+  }
+
+  /**
+   * Random sorted inputs drawn from a shared pool of sites, the merge yields every
+   * distinct site once in position order.
+   */
+  void test_random(std::mt19937 & rng)
+  {
+    using Site = std::tuple<size_t, std::string, std::string>;
+
+    for (int round = 0; round < 100; ++round)
+    {
+      std::vector<VcfRecord> pool;
+      for (size_t position = 1; pool.size() < 200; position += rng() % 3)
+        pool.push_back(make_record("1", position, "A", std::string(1, "CGT"[rng() % 3])));
+      pool.erase(std::unique(pool.begin(), pool.end(), [](const VcfRecord & a, const VcfRecord & b)
+      {
+        return a.position == b.position && a.alt == b.alt;
+      }), pool.end());
+
+      size_t input_count = 2 + rng() % 6;
+      std::vector<std::vector<VcfRecord>> inputs(input_count);
+      std::map<Site, size_t> expected;
+      size_t total = 0;
+      for (const auto & record : pool)
+      {
+        for (auto & input : inputs)
+        {
+          if (rng() % 3 != 0)
+            continue;
+          input.push_back(record);
+          expected[Site(record.position, record.ref, record.alt[0])]++;
+          ++total;
+        }
+      }
+
+      size_t duplicates = 0;
+      auto records = merge(inputs, duplicates);
+      std::map<Site, size_t> merged;
+      bool sorted = true;
+      for (size_t i = 0; i < records.size(); ++i)
+      {
+        merged[Site(records[i].position, records[i].ref, records[i].alt[0])]++;
+        sorted = sorted && (i == 0 || records[i - 1].position <= records[i].position);
+      }
+
+      std::string what = "merge of " + std::to_string(input_count) + " inputs";
+      check(sorted, what + ", order");
+      check(merged.size() == expected.size() && records.size() == expected.size(), what + ", sites collapsed");
+      check(duplicates == total - expected.size(), what + ", duplicate count");
+    }
+  }
+}
+
+int main()
+{
+  std::mt19937 rng(7);
+  test_genotypes();
+  test_random(rng);
+  return test_result();
+}
@@ -0,0 +1,88 @@
+#include "packed_sequence.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+/**
+ * Checks the kernel selected for PackedSequence against the sequence it encodes.
+ * CTest runs it once per VCF2EDS_KERNEL value, so every SIMD kernel the CPU supports
+ * is compared with the input.
+ */
+namespace
+{
+  /**
+   * Mostly ACGT with runs of N, soft-masked bases and other IUPAC codes, which leave
+   * the fast path of the encoder.
+   */
+  std::string random_sequence(std::mt19937 & rng, size_t length)
+  {
+    std::string sequence;
+    while (sequence.length() < length)
+    {
+      size_t kind = rng() % 10;
+      if (kind < 6)
+      {
+        sequence += random_bases(rng, 1 + rng() % 200);
+        continue;
+      }
+
+      char base = kind == 6 ? 'N' : kind == 7 ? "acgtn"[rng() % 5] : kind == 8 ? "RYKM"[rng() % 4] : '-';
+      sequence.append(1 + rng() % 40, base);
+    }
+    sequence.resize(length);
+    return sequence;
+  }
+
+  void test_round_trip(std::mt19937 & rng)
+  {
+    for (int round = 0; round < 200; ++round)
+    {
+      std::string sequence = random_sequence(rng, rng() % 5000);
+
+      // appended in pieces, so the words are filled across calls
+      PackedSequence packed;
+      for (size_t offset = 0; offset < sequence.length(); )
+      {
+        size_t count = std::min<size_t>(sequence.length() - offset, rng() % 100);
+        packed.append(sequence.data() + offset, count);
+        offset += count;
+      }
+
+      check(packed.length() == sequence.length() && packed.decode(0, sequence.length()) == sequence,
+            "packed sequence round trip");
+      for (int query = 0; query < 50; ++query)
+      {
+        size_t offset = rng() % (sequence.length() + 1);
+        size_t count = rng() % 300;
+        check(packed.decode(offset, count) == sequence.substr(offset, count), "packed sequence decode of a range");
+      }
+    }
+  }
+
+  /**
+   * A forced kernel is used when the CPU supports it, the scalar one otherwise.
+   */
+  void test_selection()
+  {
+    const char * forced = std::getenv("VCF2EDS_KERNEL");
+    if (!forced)
+      return;
+
+    check(std::strcmp(PackedSequence::kernel(), forced) == 0 || std::strcmp(PackedSequence::kernel(), "scalar") == 0,
+          std::string("packed sequence kernel ") + PackedSequence::kernel() + " for " + forced);
+  }
+}
+
+int main()
+{
+  std::cout << "packed sequence kernel: " << PackedSequence::kernel() << std::endl;
+
+  std::mt19937 rng(4);
+  test_selection();
+  test_round_trip(rng);
+  return test_result();
+}
@@ -0,0 +1,101 @@
+#include "eds.h"
+#include "eds_index.h"
+#include "test_utils.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Saves an EDS on several threads and compares the output and its index with a serial
+ * save. tests/data/expected.eds is repeated until the output spans several of the
+ * ranges a parallel save formats at once.
+ *
+ * usage: parallel_save_test <data directory> <work directory>
+ */
+namespace
+{
+  constexpr size_t index_stride = 256;
+  constexpr size_t output_size = 16 << 20;
+
+  std::string save(const EDS & eds, EDS::Format format, EdsIndex * index = nullptr, int threads = 1)
+  {
+    std::ostringstream os;
+    eds.save(os, format, index, threads);
+    return os.str();
+  }
+
+  bool same_checkpoints(const EdsIndex & first, const EdsIndex & second)
+  {
+    if (first.contigs().size() != 1 || second.contigs().size() != 1)
+      return false;
+
+    const auto & a = first.contigs()[0];
+    const auto & b = second.contigs()[0];
+    if (a.segment_count != b.segment_count || a.end_position != b.end_position
+        || a.checkpoints.size() != b.checkpoints.size())
+      return false;
+
+    for (size_t i = 0; i < a.checkpoints.size(); ++i)
+    {
+      if (a.checkpoints[i].position != b.checkpoints[i].position
+          || a.checkpoints[i].segment != b.checkpoints[i].segment
+          || a.checkpoints[i].offset != b.checkpoints[i].offset)
+        return false;
+    }
+    return true;
+  }
+
+  void test_parallel_save(const EDS & eds, EDS::Format format, const std::string & name)
+  {
+    bool binary = format == EDS::Format::binary;
+    EdsIndex serial_index(index_stride, binary);
+    std::string serial = save(eds, format, &serial_index);
+
+    for (int threads : {2, 4})
+    {
+      std::string what = name + " save, " + std::to_string(threads) + " threads";
+      check(save(eds, format, nullptr, threads) == serial, what);
+
+      EdsIndex index(index_stride, binary);
+      check(save(eds, format, &index, threads) == serial, "indexed " + what);
+      check(same_checkpoints(index, serial_index), "index of " + what);
+    }
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: parallel_save_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string data_dir = argv[1];
+  try
+  {
+    std::string expected = read_file(data_dir + "/expected.eds");
+    if (expected.empty())
+      throw std::runtime_error("Missing test data in " + data_dir);
+
+    std::string repeated;
+    while (repeated.length() < output_size)
+      repeated += expected;
+
+    std::istringstream is(repeated);
+    EDS eds;
+    eds.load(is);
+    check(save(eds, EDS::Format::text) == repeated, "serial save of the repeated EDS");
+
+    test_parallel_save(eds, EDS::Format::text, "text");
+    test_parallel_save(eds, EDS::Format::binary, "binary");
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
@@ -0,0 +1,137 @@
+#include "eds_parser.h"
+#include "test_utils.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Parses random text EDS with EdsTextParser and compares the segments with the groups
+ * the text was built from. CTest runs it once per VCF2EDS_KERNEL value, so every SIMD
+ * delimiter scanning kernel the CPU supports is checked.
+ */
+namespace
+{
+  using Group = std::pair<std::string, std::vector<std::string>>;
+
+  /**
+   * Random text EDS and the groups it consists of, reference runs have no alternatives.
+   */
+  std::string random_eds(std::mt19937 & rng, std::vector<Group> & groups)
+  {
+    std::string text;
+    bool after_run = false;
+    for (size_t count = rng() % 40; count > 0; --count)
+    {
+      if (rng() % 2 && !after_run)
+      {
+        std::string run = random_bases(rng, 1 + rng() % (rng() % 4 == 0 ? 3000 : 50));
+        text += run;
+        groups.push_back(Group{run, {}});
+        after_run = true;
+        continue;
+      }
+
+      Group group{random_bases(rng, rng() % 4), {}};
+      text += '{' + group.first;
+      for (size_t variants = 1 + rng() % (rng() % 5 == 0 ? 200 : 4); variants > 0; --variants)
+      {
+        group.second.push_back(random_bases(rng, rng() % 6));
+        text += ',' + group.second.back();
+      }
+      text += '}';
+      groups.push_back(group);
+      after_run = false;
+    }
+    return text;
+  }
+
+  void test_random(std::mt19937 & rng)
+  {
+    for (int round = 0; round < 200; ++round)
+    {
+      std::vector<Group> expected;
+      std::string text = random_eds(rng, expected);
+
+      // small buffers split runs and make groups straddle refills
+      for (size_t buffer_size : {64, 100, 333, 4096})
+      {
+        std::istringstream is(text);
+        EdsTextParser parser(is, 1, buffer_size);
+        std::vector<Group> groups;
+        size_t position = 1;
+        bool positions_match = true;
+        for (const auto & segment : parser)
+        {
+          positions_match = positions_match && segment.position == position;
+          position += segment.reference.length;
+
+          // pieces of a run split by the buffer are joined again
+          if (!segment.is_degenerate() && !groups.empty() && groups.back().second.empty())
+          {
+            groups.back().first += segment.reference.str();
+            continue;
+          }
+
+          Group group{segment.reference.str(), {}};
+          for (const auto & variant : segment.variants)
+            group.second.push_back(variant.str());
+          groups.push_back(group);
+        }
+
+        std::string what = "parser with a buffer of " + std::to_string(buffer_size) + " bytes";
+        check(groups == expected, what);
+        check(positions_match, what + ", positions");
+      }
+    }
+  }
+
+  void test_malformed()
+  {
+    for (std::string text : {"AC{A", "AC{A}", "{A,C", "AC}G", "{A,C}T}"})
+    {
+      std::istringstream is(text);
+      EdsTextParser parser(is, 1, 64);
+      bool thrown = false;
+      try
+      {
+        for (const auto & segment : parser)
+          (void) segment;
+      }
+      catch (const std::runtime_error &)
+      {
+        thrown = true;
+      }
+      check(thrown, "parser rejects " + text);
+    }
+  }
+
+  /**
+   * A forced kernel is used when the CPU supports it, the scalar one otherwise.
+   */
+  void test_selection()
+  {
+    const char * forced = std::getenv("VCF2EDS_KERNEL");
+    if (!forced)
+      return;
+
+    check(std::strcmp(EdsTextParser::kernel(), forced) == 0 || std::strcmp(EdsTextParser::kernel(), "scalar") == 0,
+          std::string("parser kernel ") + EdsTextParser::kernel() + " for " + forced);
+  }
+}
+
+int main()
+{
+  std::cout << "parser kernel: " << EdsTextParser::kernel() << std::endl;
+
+  std::mt19937 rng(21);
+  test_selection();
+  test_random(rng);
+  test_malformed();
+  return test_result();
+}
@@ -0,0 +1,154 @@
+#include "converter.h"
+#include "eds.h"
+#include "eds_index.h"
+#include "eds_pipeline.h"
+#include "reference.h"
+#include "streaming_builder.h"
+#include "test_utils.h"
+#include "vcf_reader.h"
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Writes the segments of build_eds and of StreamingBuilder for tests/data/variants.vcf
+ * through PipelinedEdsWriter and compares the output with tests/data/expected.eds, and
+ * its index with the one of a serial save. An aborted writer must stop without
+ * writing the rest.
+ *
+ * usage: pipeline_test <data directory> <work directory>
+ */
+namespace
+{
+  constexpr size_t index_stride = 64;
+
+  std::vector<VcfRecord> read_records(const std::string & vcf_file)
+  {
+    std::vector<VcfRecord> records;
+    auto reader = VcfReader::open(vcf_file, VcfReader::Backend::htslib);
+    if (!reader->is_open())
+      throw std::runtime_error("Could not open " + vcf_file);
+
+    VcfRecord record;
+    while (reader->next(record))
+      records.push_back(record);
+    return records;
+  }
+
+  VariantMap variant_map(const std::vector<VcfRecord> & records)
+  {
+    VariantMap variants_pos;
+    for (const auto & record : records)
+      add_variant(variants_pos, record);
+    return variants_pos;
+  }
+
+  bool same_checkpoints(const EdsIndex & first, const EdsIndex & second)
+  {
+    if (first.contigs().size() != 1 || second.contigs().size() != 1)
+      return false;
+
+    const auto & a = first.contigs()[0];
+    const auto & b = second.contigs()[0];
+    if (a.segment_count != b.segment_count || a.end_position != b.end_position
+        || a.checkpoints.size() != b.checkpoints.size())
+      return false;
+
+    for (size_t i = 0; i < a.checkpoints.size(); ++i)
+    {
+      if (a.checkpoints[i].position != b.checkpoints[i].position
+          || a.checkpoints[i].segment != b.checkpoints[i].segment
+          || a.checkpoints[i].offset != b.checkpoints[i].offset)
+        return false;
+    }
+    return true;
+  }
+
+  void test_build_eds(const std::vector<VcfRecord> & records, const ContigSequence & sequence,
+                      const std::string & expected)
+  {
+    EDS eds;
+    auto variants_pos = variant_map(records);
+    build_eds(variants_pos, sequence, eds);
+    EdsIndex serial_index(index_stride);
+    std::ostringstream serial;
+    eds.save(serial, EDS::Format::text, &serial_index);
+
+    std::ostringstream os;
+    EdsIndex index(index_stride);
+    index.begin_contig("1");
+    PipelinedEdsWriter writer(os, &index);
+    variants_pos = variant_map(records);
+    build_eds(variants_pos, sequence, [&writer](std::unique_ptr<Segment> && segment) { writer.add(std::move(segment)); });
+    writer.finish();
+
+    check(os.str() == expected, "pipelined output of build_eds");
+    check(same_checkpoints(index, serial_index), "index of the pipelined output");
+  }
+
+  void test_streaming(const std::vector<VcfRecord> & records, const Reference & reference,
+                      const std::string & expected)
+  {
+    std::ostringstream os;
+    PipelinedEdsWriter writer(os);
+    StreamingBuilder builder(reference, [&writer](std::unique_ptr<Segment> && segment) { writer.add(std::move(segment)); });
+    for (const auto & record : records)
+      builder.add_variant(record);
+    builder.finish();
+    writer.finish();
+    check(os.str() == expected, "pipelined output of the streaming builder");
+  }
+
+  /**
+   * Enough segments to fill the queues, abort drops what was not written yet.
+   */
+  void test_abort(const std::vector<VcfRecord> & records, const ContigSequence & sequence,
+                  const std::string & expected)
+  {
+    std::ostringstream os;
+    {
+      PipelinedEdsWriter writer(os);
+      for (int round = 0; round < 20; ++round)
+      {
+        auto variants_pos = variant_map(records);
+        build_eds(variants_pos, sequence, [&writer](std::unique_ptr<Segment> && segment) { writer.add(std::move(segment)); });
+      }
+      writer.abort();
+      writer.abort();
+    }
+    check(os.str().length() < 20 * expected.length(), "aborted output is not completed");
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: pipeline_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string data_dir = argv[1];
+  try
+  {
+    std::string expected = read_file(data_dir + "/expected.eds");
+    auto reference = Reference::open(data_dir + "/ref.fa");
+    if (expected.empty() || !reference || !reference->resolve("1"))
+      throw std::runtime_error("Missing test data in " + data_dir);
+
+    auto records = read_records(data_dir + "/variants.vcf");
+    test_build_eds(records, *reference->resolve("1"), expected);
+    test_streaming(records, *reference, expected);
+    test_abort(records, *reference->resolve("1"), expected);
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
@@ -0,0 +1,98 @@
+#include "bgzf_stream.h"
+#include "converter.h"
+#include "eds.h"
+#include "reference.h"
+#include "test_utils.h"
+#include "vcf_reader.h"
+
+#include <htslib/tbx.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Converts tests/data/variants.vcf with build_eds and with ContigConverter split into
+ * shards, and compares both with tests/data/expected.eds. Clusters of the VCF cross
+ * the shard boundaries and its last record lies past the end of the reference.
+ *
+ * usage: sharding_test <data directory> <work directory>
+ */
+namespace
+{
+  /**
+   * Compresses the VCF into work_dir and builds its tabix index, which the shards are
+   * read through.
+   */
+  std::string prepare_vcf(const std::string & data_dir, const std::string & work_dir)
+  {
+    std::string vcf_file = work_dir + "/variants.vcf.gz";
+    BgzfOutputStream os(vcf_file);
+    os << read_file(data_dir + "/variants.vcf");
+    if (!os.close() || tbx_index_build(vcf_file.c_str(), 0, &tbx_conf_vcf) != 0)
+      throw std::runtime_error("Could not compress and index " + vcf_file);
+    return vcf_file;
+  }
+
+  std::string save(const EDS & eds)
+  {
+    std::ostringstream os;
+    eds.save(os);
+    return os.str();
+  }
+
+  void test_serial(const std::string & vcf_file, const Reference & reference, const std::string & expected)
+  {
+    VariantMap variants_pos;
+    auto reader = VcfReader::open(vcf_file, VcfReader::Backend::htslib);
+    VcfRecord record;
+    while (reader->next(record))
+      add_variant(variants_pos, record);
+
+    EDS eds;
+    build_eds(variants_pos, *reference.resolve("1"), eds);
+    check(save(eds) == expected, "serial conversion");
+  }
+
+  void test_sharded(const std::string & vcf_file, const Reference & reference, const std::string & expected)
+  {
+    std::vector<std::string> vcf_files{vcf_file};
+    for (int shards : {1, 3, 8})
+    {
+      ContigConverter converter(vcf_files, reference, nullptr, shards);
+      std::string output;
+      converter.run(converter.contigs(), 2, [&output](const std::string &, EDS && eds) { output += save(eds); });
+      check(output == expected, "sharded conversion, " + std::to_string(shards) + " shards");
+    }
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: sharding_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string data_dir = argv[1];
+  try
+  {
+    std::string expected = read_file(data_dir + "/expected.eds");
+    auto reference = Reference::open(data_dir + "/ref.fa");
+    if (expected.empty() || !reference || !reference->resolve("1"))
+      throw std::runtime_error("Missing test data in " + data_dir);
+
+    std::string vcf_file = prepare_vcf(data_dir, argv[2]);
+    test_serial(vcf_file, *reference, expected);
+    test_sharded(vcf_file, *reference, expected);
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
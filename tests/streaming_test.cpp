@@ -0,0 +1,95 @@
+#include "eds.h"
+#include "reference.h"
+#include "streaming_builder.h"
+#include "test_utils.h"
+#include "vcf_reader.h"
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Streams tests/data/variants.vcf through StreamingBuilder and compares the EDS with
+ * tests/data/expected.eds, then checks that unsorted input is rejected.
+ *
+ * usage: streaming_test <data directory> <work directory>
+ */
+namespace
+{
+  std::vector<VcfRecord> read_records(const std::string & vcf_file)
+  {
+    std::vector<VcfRecord> records;
+    auto reader = VcfReader::open(vcf_file, VcfReader::Backend::htslib);
+    if (!reader->is_open())
+      throw std::runtime_error("Could not open " + vcf_file);
+
+    VcfRecord record;
+    while (reader->next(record))
+      records.push_back(record);
+    return records;
+  }
+
+  void test_streaming(const std::vector<VcfRecord> & records, const Reference & reference,
+                      const std::string & expected)
+  {
+    EDS eds;
+    StreamingBuilder builder(reference, [&eds](std::unique_ptr<Segment> && segment) { eds.add_segment(std::move(segment)); });
+    for (const auto & record : records)
+      builder.add_variant(record);
+    builder.finish();
+
+    std::ostringstream os;
+    eds.save(os);
+    check(os.str() == expected, "streamed EDS");
+    check(builder.max_cluster_size() < records.size(), "only clusters are held");
+  }
+
+  void test_unsorted(std::vector<VcfRecord> records, const Reference & reference)
+  {
+    std::swap(records[records.size() / 2], records[records.size() / 2 + 3]);
+    StreamingBuilder builder(reference, [](std::unique_ptr<Segment> &&) { });
+    bool thrown = false;
+    try
+    {
+      for (const auto & record : records)
+        builder.add_variant(record);
+      builder.finish();
+    }
+    catch (const UnsortedInputError &)
+    {
+      thrown = true;
+    }
+    check(thrown, "unsorted input is rejected");
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: streaming_test <data directory> <work directory>" << std::endl;
+    return 2;
+  }
+
+  std::string data_dir = argv[1];
+  try
+  {
+    std::string expected = read_file(data_dir + "/expected.eds");
+    auto reference = Reference::open(data_dir + "/ref.fa");
+    if (expected.empty() || !reference)
+      throw std::runtime_error("Missing test data in " + data_dir);
+
+    auto records = read_records(data_dir + "/variants.vcf");
+    test_streaming(records, *reference, expected);
+    test_unsorted(records, *reference);
+  }
+  catch (const std::exception & e)
+  {
+    std::cerr << "FAILED: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return test_result();
+}
@@ -0,0 +1,47 @@
+#ifndef VCF2EDS_TEST_UTILS_H
+#define VCF2EDS_TEST_UTILS_H
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+
+/**
+ * Checks shared by the test programs. A failed check is reported and counted, the
+ * program goes on and exits with test_result() so that one run lists every failure.
+ */
+inline int & test_failures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+inline void check(bool condition, const std::string & what)
+{
+  if (condition)
+    return;
+  std::cerr << "FAILED: " << what << std::endl;
+  ++test_failures();
+}
+
+inline int test_result()
+{
+  return test_failures() ? 1 : 0;
+}
+
+inline std::string read_file(const std::string & filename)
+{
+  std::ifstream is(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+inline std::string random_bases(std::mt19937 & rng, size_t length)
+{
+  std::string bases;
+  for (size_t i = 0; i < length; ++i)
+    bases += "ACGT"[rng() % 4];
+  return bases;
+}
+
+#endif //VCF2EDS_TEST_UTILS_H